@@ -0,0 +1,90 @@
+#include "AdminServer.h"
+#include <iostream>
+
+using json = nlohmann::json;
+
+AdminServer::AdminServer(zmq::context_t& context, const std::string& endpoint)
+    : socket_(context, ZMQ_REP), endpoint_(endpoint) {
+}
+
+AdminServer::~AdminServer() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void AdminServer::addSetting(const std::string& name, long long min, long long max, Getter get, Setter set) {
+    settings_[name] = Setting{min, max, get, set};
+}
+
+void AdminServer::addCommand(const std::string& name, Command command) {
+    commands_[name] = command;
+}
+
+void AdminServer::start() {
+    socket_.set(zmq::sockopt::rcvtimeo, 200); // lets serve() notice shutdown
+    socket_.set(zmq::sockopt::linger, 0);
+    socket_.bind(endpoint_);
+    running_ = true;
+    thread_ = std::thread([this]() {
+        serve();
+    });
+    std::cout << "Admin socket is running on " << endpoint_ << std::endl;
+}
+
+void AdminServer::serve() {
+    while (running_) {
+        zmq::message_t message;
+        if (!socket_.recv(message, zmq::recv_flags::none)) {
+            continue;
+        }
+        json reply;
+        try {
+            reply = handle(json::parse(message.to_string()));
+        } catch (const json::exception& e) {
+            reply = {{"error", e.what()}};
+        } catch (const std::exception& e) {
+            // A setter failed part way, e.g. opening new connections
+            reply = {{"error", e.what()}};
+        }
+        std::string text = reply.dump();
+        socket_.send(zmq::buffer(text), zmq::send_flags::none);
+    }
+}
+
+json AdminServer::handle(const json& request) {
+    std::string command = request.value("command", "");
+    if (command == "set") {
+        const json& changes = request.at("settings");
+        for (auto& change : changes.items()) {
+            auto it = settings_.find(change.key());
+            if (it == settings_.end()) {
+                return {{"error", "Unknown setting " + change.key()}};
+            }
+            long long value = change.value().get<long long>();
+            if (value < it->second.min || value > it->second.max) {
+                return {{"error", change.key() + " must be between " + std::to_string(it->second.min) + " and " +
+                                      std::to_string(it->second.max)}};
+            }
+        }
+        for (auto& change : changes.items()) {
+            long long value = change.value().get<long long>();
+            std::cout << "Admin: " << change.key() << " = " << value << std::endl;
+            settings_[change.key()].set(value);
+        }
+    } else if (commands_.count(command)) {
+        return commands_[command](request);
+    } else if (command != "get") {
+        return {{"error", "Unknown command " + command}};
+    }
+    return {{"settings", currentSettings()}};
+}
+
+json AdminServer::currentSettings() {
+    json values = json::object();
+    for (auto& setting : settings_) {
+        values[setting.first] = setting.second.get();
+    }
+    return values;
+}
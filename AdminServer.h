@@ -0,0 +1,57 @@
+#ifndef ADMIN_SERVER_H
+#define ADMIN_SERVER_H
+
+#include <string>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "cppzmq/zmq.hpp"
+#include "nlohmann/json.hpp"
+
+// Operator control socket (ZMQ REP, JSON messages) for changing tunables
+// without a restart:
+//
+//   {"command": "get"}
+//   {"command": "set", "settings": {"oltp_workers": 120, "queue_capacity": 50000}}
+//
+// Both reply {"settings": {...}} with every current value, or {"error": "..."}.
+// A set is validated as a whole before anything is applied. Other commands
+// are registered with addCommand() and reply with whatever their handler
+// returns.
+class AdminServer {
+public:
+    typedef std::function<long long()> Getter;
+    typedef std::function<void(long long)> Setter;
+    typedef std::function<nlohmann::json(const nlohmann::json& request)> Command;
+
+    AdminServer(zmq::context_t& context, const std::string& endpoint);
+    ~AdminServer();
+
+    // Register settings before start()
+    void addSetting(const std::string& name, long long min, long long max, Getter get, Setter set);
+    void addCommand(const std::string& name, Command command);
+    void start();
+
+private:
+    struct Setting {
+        long long min;
+        long long max;
+        Getter get;
+        Setter set;
+    };
+
+    void serve();
+    nlohmann::json handle(const nlohmann::json& request);
+    nlohmann::json currentSettings();
+
+private:
+    zmq::socket_t socket_;
+    std::string endpoint_;
+    std::map<std::string, Setting> settings_;
+    std::map<std::string, Command> commands_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+};
+
+#endif
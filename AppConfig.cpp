@@ -1,34 +1,192 @@
 #include "AppConfig.h"
+#include <cstdlib>
 
 
 namespace PaulNovack {
 
+  namespace {
+
+    struct StringSetting {
+      const char* key;
+      string AppConfig::* field;
+    };
+
+    struct IntSetting {
+      const char* key;
+      int AppConfig::* field;
+      int min;
+    };
+
+    const StringSetting stringSettings[] = {
+      {"DB_DATABASE_NAME", &AppConfig::DB_DATABASE_NAME},
+      {"DB_USERNAME", &AppConfig::DB_USERNAME},
+      {"DB_PASSWORD", &AppConfig::DB_PASSWORD},
+      {"DB_HOST", &AppConfig::DB_HOST},
+      {"SERVER_ENDPOINT", &AppConfig::SERVER_ENDPOINT},
+      {"ADMIN_ENDPOINT", &AppConfig::ADMIN_ENDPOINT},
+      {"METRICS_ENDPOINT", &AppConfig::METRICS_ENDPOINT},
+      {"QUERY_REGISTRY_FILE", &AppConfig::QUERY_REGISTRY_FILE},
+      {"LOG_LEVEL", &AppConfig::LOG_LEVEL},
+      {"SPAN_FILE", &AppConfig::SPAN_FILE},
+      {"CAPTURE_FILE", &AppConfig::CAPTURE_FILE},
+      {"BACKEND", &AppConfig::BACKEND},
+      {"SYNTHETIC_COLUMNS", &AppConfig::SYNTHETIC_COLUMNS},
+    };
+
+    const IntSetting intSettings[] = {
+      {"DB_HEARTBEAT_INTERVAL", &AppConfig::DB_HEARTBEAT_INTERVAL, 1},
+      {"DB_POOL_SIZE", &AppConfig::DB_POOL_SIZE, 1},
+      {"DB_STARTUP_DELAY_SECONDS", &AppConfig::DB_STARTUP_DELAY_SECONDS, 0},
+      {"DB_CHECKOUT_DELAY_US", &AppConfig::DB_CHECKOUT_DELAY_US, 0},
+      {"DB_ANALYTIC_CONNECTIONS", &AppConfig::DB_ANALYTIC_CONNECTIONS, 1},
+      {"DB_INTERNAL_CONNECTIONS", &AppConfig::DB_INTERNAL_CONNECTIONS, 1},
+      {"WORKER_THREADS", &AppConfig::WORKER_THREADS, 1},
+      {"ANALYTIC_WORKER_THREADS", &AppConfig::ANALYTIC_WORKER_THREADS, 1},
+      {"WORKER_SLEEP_US", &AppConfig::WORKER_SLEEP_US, 0},
+      {"RECEIVE_SLEEP_US", &AppConfig::RECEIVE_SLEEP_US, 0},
+      {"QUEUE_PRIORITY_CLASSES", &AppConfig::QUEUE_PRIORITY_CLASSES, 1},
+      {"QUEUE_AGING_THRESHOLD_MS", &AppConfig::QUEUE_AGING_THRESHOLD_MS, 1},
+      {"QUEUE_FAIR_QUANTUM", &AppConfig::QUEUE_FAIR_QUANTUM, 1},
+      {"QUEUE_MAX_OUTSTANDING_PER_CLIENT", &AppConfig::QUEUE_MAX_OUTSTANDING_PER_CLIENT, 1},
+      {"QUEUE_CAPACITY", &AppConfig::QUEUE_CAPACITY, 1},
+      {"QUEUE_CODEL_TARGET_MS", &AppConfig::QUEUE_CODEL_TARGET_MS, 1},
+      {"QUEUE_CODEL_INTERVAL_MS", &AppConfig::QUEUE_CODEL_INTERVAL_MS, 1},
+      {"ANALYTIC_QUEUE_CAPACITY", &AppConfig::ANALYTIC_QUEUE_CAPACITY, 1},
+      {"ANALYTIC_CODEL_TARGET_MS", &AppConfig::ANALYTIC_CODEL_TARGET_MS, 1},
+      {"ANALYTIC_CODEL_INTERVAL_MS", &AppConfig::ANALYTIC_CODEL_INTERVAL_MS, 1},
+      {"ANALYTIC_LATENCY_MS", &AppConfig::ANALYTIC_LATENCY_MS, 1},
+      {"CONCURRENCY_INITIAL", &AppConfig::CONCURRENCY_INITIAL, 1},
+      {"CONCURRENCY_MIN", &AppConfig::CONCURRENCY_MIN, 1},
+      {"CONCURRENCY_MAX", &AppConfig::CONCURRENCY_MAX, 1},
+      {"WATCHDOG_INTERVAL_MS", &AppConfig::WATCHDOG_INTERVAL_MS, 1},
+      {"WRITE_BEHIND_FLUSH_INTERVAL_MS", &AppConfig::WRITE_BEHIND_FLUSH_INTERVAL_MS, 1},
+      {"WRITE_BEHIND_MAX_ROWS", &AppConfig::WRITE_BEHIND_MAX_ROWS, 1},
+      {"FINGERPRINT_STATS_MAX", &AppConfig::FINGERPRINT_STATS_MAX, 16},
+      {"LOG_RATE_PER_SECOND", &AppConfig::LOG_RATE_PER_SECOND, 0},
+      {"SPAN_FILE_MAX_MB", &AppConfig::SPAN_FILE_MAX_MB, 1},
+      {"SPAN_FILE_KEEP", &AppConfig::SPAN_FILE_KEEP, 0},
+      {"SPAN_SAMPLE_PERCENT", &AppConfig::SPAN_SAMPLE_PERCENT, 0},
+      {"SPAN_SLOW_MS", &AppConfig::SPAN_SLOW_MS, 1},
+      {"CAPTURE_MAX_MB", &AppConfig::CAPTURE_MAX_MB, 1},
+      {"SYNTHETIC_ROWS", &AppConfig::SYNTHETIC_ROWS, 0},
+      {"SYNTHETIC_VALUE_BYTES", &AppConfig::SYNTHETIC_VALUE_BYTES, 0},
+      {"SYNTHETIC_LATENCY_US", &AppConfig::SYNTHETIC_LATENCY_US, 0},
+      {"LARGE_REPLY_BYTES", &AppConfig::LARGE_REPLY_BYTES, 0},
+      {"REPLY_CHUNK_BYTES", &AppConfig::REPLY_CHUNK_BYTES, 4096},
+      {"ZEROMQ_IO_THREADS", &AppConfig::ZEROMQ_IO_THREADS, 1},
+      {"ZEROMQ_SNDHWM", &AppConfig::ZEROMQ_SNDHWM, 0},
+      {"ZEROMQ_RCVHWM", &AppConfig::ZEROMQ_RCVHWM, 0},
+      {"ZEROMQ_SNDBUF", &AppConfig::ZEROMQ_SNDBUF, 0},
+      {"ZEROMQ_RCVBUF", &AppConfig::ZEROMQ_RCVBUF, 0},
+    };
+
+  }
+
   AppConfig::AppConfig(const string& filePath) {
     ifstream file(filePath);
     if (!file.is_open()) {
-      cerr << "Failed to open .env file." << endl;
-      return;
+      cout << "No " << filePath << " file, using defaults and environment." << endl;
     }
     string line;
     while (getline(file, line)) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
       size_t delimiterPos = line.find('=');
       if (delimiterPos != string::npos) {
         string key = line.substr(0, delimiterPos);
         string value = line.substr(delimiterPos + 1);
-        if (key == "DB_DATABASE_NAME")
-          DB_DATABASE_NAME = value;
-        else if (key == "DB_USERNAME")
-          DB_USERNAME = value;
-        else if (key == "DB_PASSWORD")
-          DB_PASSWORD = value;
-        else if (key == "DB_HOST")
-          DB_HOST = value;
-        else if (key == "DB_HEARTBEAT_INTERVAL")
-          DB_HEARTBEAT_INTERVAL = stoi(value);
-        else if (key == "DB_POOL_SIZE")
-          DB_POOL_SIZE = stoi(value);
+        set(key, value, filePath);
       }
     }
     file.close();
+
+    // The environment overrides the file
+    for (const StringSetting& setting : stringSettings) {
+      if (const char* value = getenv(setting.key)) {
+        set(setting.key, value, "environment");
+      }
+    }
+    for (const IntSetting& setting : intSettings) {
+      if (const char* value = getenv(setting.key)) {
+        set(setting.key, value, "environment");
+      }
+    }
+  }
+
+  void AppConfig::set(const string& key, const string& value, const string& source) {
+    for (const StringSetting& setting : stringSettings) {
+      if (key == setting.key) {
+        this->*setting.field = value;
+        return;
+      }
+    }
+    for (const IntSetting& setting : intSettings) {
+      if (key == setting.key) {
+        size_t end = 0;
+        try {
+          this->*setting.field = stoi(value, &end);
+        } catch (const exception&) {
+          end = 0;
+        }
+        if (end == 0 || end != value.size()) {
+          errors_.push_back(key + " in " + source + " is not an integer: '" + value + "'");
+        }
+        return;
+      }
+    }
+    cerr << "Ignoring unknown setting " << key << " in " << source << endl;
+  }
+
+  vector<string> AppConfig::validate() const {
+    vector<string> errors = errors_;
+    for (const IntSetting& setting : intSettings) {
+      if (this->*setting.field < setting.min) {
+        errors.push_back(string(setting.key) + " must be at least " + to_string(setting.min));
+      }
+    }
+    for (const StringSetting& setting : stringSettings) {
+      bool optional = string(setting.key) == "DB_PASSWORD" || string(setting.key) == "SPAN_FILE" ||
+                      string(setting.key) == "CAPTURE_FILE";
+      if ((this->*setting.field).empty() && !optional) {
+        errors.push_back(string(setting.key) + " must not be empty");
+      }
+    }
+    if (LOG_LEVEL != "debug" && LOG_LEVEL != "info" && LOG_LEVEL != "warn" && LOG_LEVEL != "error") {
+      errors.push_back("LOG_LEVEL must be debug, info, warn or error");
+    }
+    if (BACKEND != "mysql" && BACKEND != "synthetic") {
+      errors.push_back("BACKEND must be mysql or synthetic");
+    }
+    if (SPAN_SAMPLE_PERCENT > 100) {
+      errors.push_back("SPAN_SAMPLE_PERCENT must be at most 100");
+    }
+    if (CONCURRENCY_MIN > CONCURRENCY_MAX) {
+      errors.push_back("CONCURRENCY_MIN must not exceed CONCURRENCY_MAX");
+    }
+    if (DB_ANALYTIC_CONNECTIONS >= DB_POOL_SIZE) {
+      errors.push_back("DB_ANALYTIC_CONNECTIONS must be below DB_POOL_SIZE so OLTP keeps a reserve");
+    }
+    if (SERVER_ENDPOINT == ADMIN_ENDPOINT || SERVER_ENDPOINT == METRICS_ENDPOINT || ADMIN_ENDPOINT == METRICS_ENDPOINT) {
+      errors.push_back("SERVER_ENDPOINT, ADMIN_ENDPOINT and METRICS_ENDPOINT must differ");
+    }
+    return errors;
+  }
+
+  void AppConfig::printSummary(ostream& out) const {
+    out << "Effective configuration:" << endl;
+    for (const StringSetting& setting : stringSettings) {
+      string value = this->*setting.field;
+      if (string(setting.key) == "DB_PASSWORD") {
+        value = value.empty() ? "(empty)" : "********";
+      }
+      out << "  " << setting.key << "=" << value << endl;
+    }
+    for (const IntSetting& setting : intSettings) {
+      out << "  " << setting.key << "=" << this->*setting.field << endl;
+    }
   }
-}
\ No newline at end of file
+}
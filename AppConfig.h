@@ -4,22 +4,110 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 using namespace std;
 
 namespace PaulNovack {
 
+    // Server settings read from a .env file (KEY=value per line) and then
+    // from environment variables of the same name, which take precedence.
+    // Every field has a default, so both sources are optional.
     class AppConfig {
     public:
         AppConfig(const std::string& filePath);
-        string DB_DATABASE_NAME;
-        string DB_USERNAME;
-        string DB_PASSWORD;
-        string DB_HOST;
-        int DB_HEARTBEAT_INTERVAL;
-        int DB_POOL_SIZE;
-        
+
+        // Problems found while parsing and range-checking; empty when valid
+        vector<string> validate() const;
+        // Effective settings, one per line, with the password masked
+        void printSummary(ostream& out) const;
+
+        // Database
+        string DB_DATABASE_NAME = "testdb";
+        string DB_USERNAME = "root";
+        string DB_PASSWORD = "password";
+        string DB_HOST = "mysql:3306";
+        int DB_HEARTBEAT_INTERVAL = 60;
+        int DB_POOL_SIZE = 80;
+        int DB_STARTUP_DELAY_SECONDS = 60;  // wait for MySQL before connecting
+        int DB_CHECKOUT_DELAY_US = 500;     // yield before each connection checkout
+        int DB_ANALYTIC_CONNECTIONS = 16;
+        int DB_INTERNAL_CONNECTIONS = 4;    // write-behind flushes and table cache loads
+
+        // Endpoints
+        string SERVER_ENDPOINT = "tcp://0.0.0.0:5555";
+        string ADMIN_ENDPOINT = "tcp://127.0.0.1:5556";
+        string METRICS_ENDPOINT = "tcp://0.0.0.0:9100"; // Prometheus GET /metrics
+        string QUERY_REGISTRY_FILE = "queries.json";
+
+        // Workers
+        int WORKER_THREADS = 80;
+        int ANALYTIC_WORKER_THREADS = 16;
+        int WORKER_SLEEP_US = 20;           // after each request
+        int RECEIVE_SLEEP_US = 20;          // after each received message
+
+        // Scheduling and overload protection
+        int QUEUE_PRIORITY_CLASSES = 3;
+        int QUEUE_AGING_THRESHOLD_MS = 250;
+        int QUEUE_FAIR_QUANTUM = 4;
+        int QUEUE_MAX_OUTSTANDING_PER_CLIENT = 1000;
+        int QUEUE_CAPACITY = 20000;
+        int QUEUE_CODEL_TARGET_MS = 20;
+        int QUEUE_CODEL_INTERVAL_MS = 200;
+        int ANALYTIC_QUEUE_CAPACITY = 2000;
+        int ANALYTIC_CODEL_TARGET_MS = 1000;
+        int ANALYTIC_CODEL_INTERVAL_MS = 5000;
+        int ANALYTIC_LATENCY_MS = 250;
+        int CONCURRENCY_INITIAL = 20;
+        int CONCURRENCY_MIN = 4;
+        int CONCURRENCY_MAX = 80;
+
+        // Query handling
+        int WATCHDOG_INTERVAL_MS = 5;
+        int WRITE_BEHIND_FLUSH_INTERVAL_MS = 5;
+        int WRITE_BEHIND_MAX_ROWS = 1000;
+        int FINGERPRINT_STATS_MAX = 5000;   // statement shapes tracked for top_queries
+
+        // Span export; an empty SPAN_FILE disables it
+        string SPAN_FILE = "";
+        int SPAN_FILE_MAX_MB = 64;          // rotate once the file reaches this size
+        int SPAN_FILE_KEEP = 3;             // rotated files kept
+        int SPAN_SAMPLE_PERCENT = 1;        // traces sampled at the head
+        int SPAN_SLOW_MS = 100;             // slower requests are always exported
+
+        // Request capture for replay; an empty CAPTURE_FILE disables it
+        string CAPTURE_FILE = "";
+        int CAPTURE_MAX_MB = 1024;          // capture stops at this file size
+
+        // Query backend: "mysql", or "synthetic" to answer with generated rows
+        // and benchmark the server without a database
+        string BACKEND = "mysql";
+        int SYNTHETIC_ROWS = 100;           // rows per SELECT (less with a smaller LIMIT)
+        string SYNTHETIC_COLUMNS = "id:int,name:string,email:string,score:double,created_at:datetime";
+        int SYNTHETIC_VALUE_BYTES = 24;     // length of string values
+        int SYNTHETIC_LATENCY_US = 0;       // added to every query
+
+        // Logging
+        string LOG_LEVEL = "info";          // debug, info, warn or error
+        int LOG_RATE_PER_SECOND = 200;      // lines per thread; 0 for no limit
+
+        // Replies of at least LARGE_REPLY_BYTES (0: never) are encoded in
+        // REPLY_CHUNK_BYTES chunks instead of one growing buffer
+        int LARGE_REPLY_BYTES = 1048576;
+        int REPLY_CHUNK_BYTES = 65536;
+
+        // ZeroMQ (ZEROMQ_ rather than ZMQ_ so names don't clash with zmq.h
+        // macros); 0 keeps the library/OS default for HWMs and buffers
+        int ZEROMQ_IO_THREADS = 1;
+        int ZEROMQ_SNDHWM = 0;
+        int ZEROMQ_RCVHWM = 0;
+        int ZEROMQ_SNDBUF = 0;
+        int ZEROMQ_RCVBUF = 0;
+
     private:
+        void set(const string& key, const string& value, const string& source);
+
+        vector<string> errors_;
     };
 }
 #endif  // CONFIG_HPP
@@ -0,0 +1,95 @@
+#include "BulkheadClassifier.h"
+#include "SqlStatement.h"
+#include "Logger.h"
+#include <algorithm>
+#include <iostream>
+
+// Distinct statements tracked; once full, new ones are classified by rules only
+static const size_t maxHistory = 10000;
+// Samples before the latency average is trusted
+static const uint64_t minSamples = 5;
+
+BulkheadClassifier::BulkheadClassifier(const std::vector<std::string>& names, const std::vector<BulkheadRule>& rules,
+                                       int slowBulkhead, double slowLatencyMs)
+    : names_(names), slowBulkhead_(slowBulkhead), slowLatencyMs_(slowLatencyMs) {
+    for (const BulkheadRule& rule : rules) {
+        int bulkhead = find(rule.bulkhead);
+        if (bulkhead < 0) {
+            std::cerr << "Ignoring class rule '" << rule.pattern << "': unknown class " << rule.bulkhead << std::endl;
+            continue;
+        }
+        try {
+            rules_.emplace_back(std::regex(rule.pattern, std::regex::ECMAScript | std::regex::icase | std::regex::optimize), bulkhead);
+        } catch (const std::regex_error& e) {
+            std::cerr << "Ignoring class rule '" << rule.pattern << "': " << e.what() << std::endl;
+        }
+    }
+}
+
+int BulkheadClassifier::find(const std::string& name) const {
+    auto it = std::find(names_.begin(), names_.end(), name);
+    return it == names_.end() ? -1 : static_cast<int>(it - names_.begin());
+}
+
+int BulkheadClassifier::matchRules(const std::string& fingerprint) const {
+    for (const auto& rule : rules_) {
+        if (std::regex_search(fingerprint, rule.first)) {
+            return rule.second;
+        }
+    }
+    return -1;
+}
+
+void BulkheadClassifier::classify(Request& request, const NamedQuery* named, const std::string& explicitClass) {
+    request.fingerprint = named ? named->name : statementFingerprint(request.query);
+    request.fingerprintHash = fingerprintHash(request.fingerprint);
+
+    if (!explicitClass.empty()) {
+        int bulkhead = find(explicitClass);
+        if (bulkhead >= 0) {
+            request.bulkhead = bulkhead;
+            return;
+        }
+        Logger::instance().log(LogLevel::Warn, "Unknown class", {{"class", explicitClass}, {"query_id", request.queryId}});
+    }
+    if (named && !named->bulkhead.empty()) {
+        int bulkhead = find(named->bulkhead);
+        if (bulkhead >= 0) {
+            request.bulkhead = bulkhead;
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = history_.find(request.fingerprint);
+    if (it == history_.end()) {
+        History entry;
+        if (!named) {
+            entry.ruleBulkhead = matchRules(request.fingerprint);
+        }
+        if (history_.size() >= maxHistory) {
+            request.bulkhead = std::max(entry.ruleBulkhead, 0);
+            return;
+        }
+        it = history_.emplace(request.fingerprint, entry).first;
+    }
+    const History& entry = it->second;
+    if (entry.ruleBulkhead >= 0) {
+        request.bulkhead = entry.ruleBulkhead;
+    } else if (entry.samples >= minSamples && entry.avgMs >= slowLatencyMs_) {
+        request.bulkhead = slowBulkhead_;
+    } else {
+        request.bulkhead = 0;
+    }
+}
+
+void BulkheadClassifier::record(const std::string& fingerprint, double latencyMs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = history_.find(fingerprint);
+    if (it == history_.end()) {
+        return;
+    }
+    History& entry = it->second;
+    ++entry.samples;
+    entry.avgMs = entry.samples == 1 ? latencyMs : entry.avgMs + (latencyMs - entry.avgMs) / 8;
+}
@@ -0,0 +1,54 @@
+#ifndef BULKHEAD_CLASSIFIER_H
+#define BULKHEAD_CLASSIFIER_H
+
+#include <string>
+#include <vector>
+#include <regex>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "QueryRegistry.h"
+#include "Request.h"
+
+// Decides which bulkhead (isolated queue, workers and connection budget) a
+// request runs in. In order of precedence:
+//   1. the request's explicit "class" field
+//   2. the named query's "class" in queries.json
+//   3. the first "class_rules" pattern matching the raw SQL's fingerprint
+//   4. latency history: statements averaging at least slowLatencyMs run in
+//      slowBulkhead, everything else in bulkhead 0
+class BulkheadClassifier {
+public:
+    BulkheadClassifier(const std::vector<std::string>& names, const std::vector<BulkheadRule>& rules,
+                       int slowBulkhead, double slowLatencyMs);
+
+    // Index of the bulkhead with this name; -1 if there is none
+    int find(const std::string& name) const;
+    const std::string& name(int bulkhead) const { return names_[bulkhead]; }
+    size_t size() const { return names_.size(); }
+
+    // Sets request.bulkhead, fingerprint and fingerprintHash. explicitClass is the
+    // request's "class" field, or "" when it had none.
+    void classify(Request& request, const NamedQuery* named, const std::string& explicitClass);
+    // Feeds the latency history with a completed query
+    void record(const std::string& fingerprint, double latencyMs);
+
+private:
+    struct History {
+        int ruleBulkhead = -1; // from class_rules, -1 when no rule matched
+        double avgMs = 0;
+        uint64_t samples = 0;
+    };
+
+    int matchRules(const std::string& fingerprint) const;
+
+private:
+    std::vector<std::string> names_;
+    std::vector<std::pair<std::regex, int>> rules_;
+    int slowBulkhead_;
+    double slowLatencyMs_;
+    std::unordered_map<std::string, History> history_;
+    std::mutex mutex_;
+};
+
+#endif
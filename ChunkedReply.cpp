@@ -0,0 +1,53 @@
+#include "ChunkedReply.h"
+#include <cstring>
+#include <limits>
+#include <vector>
+
+ChunkedReply::ChunkedReply(size_t chunkBytes)
+    : buffer_(std::numeric_limits<size_t>::max(), chunkBytes), packer_(buffer_) {
+}
+
+size_t ChunkedReply::size() const {
+    size_t total = 0;
+    const msgpack::iovec* chunks = buffer_.vector();
+    for (size_t i = 0; i < buffer_.vector_size(); ++i) {
+        total += chunks[i].iov_len;
+    }
+    return total;
+}
+
+void ChunkedReply::send(zmq::socket_t& socket, std::unique_ptr<ChunkedReply> reply, bool multipart) {
+    const msgpack::iovec* chunks = reply->buffer_.vector();
+    size_t count = reply->buffer_.vector_size();
+    if (!multipart) {
+        zmq::message_t message(reply->size());
+        char* out = static_cast<char*>(message.data());
+        for (size_t i = 0; i < count; ++i) {
+            std::memcpy(out, chunks[i].iov_base, chunks[i].iov_len);
+            out += chunks[i].iov_len;
+        }
+        socket.send(message, zmq::send_flags::none);
+        return;
+    }
+
+    // Every frame points into the chunks; whichever frame ZeroMQ releases
+    // last frees the reply. Frames not sent are released when frames goes
+    // out of scope.
+    ChunkedReply* owner = reply.release();
+    owner->framesLeft_ = count;
+    std::vector<zmq::message_t> frames;
+    frames.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        frames.emplace_back(chunks[i].iov_base, chunks[i].iov_len, &ChunkedReply::releaseFrame, owner);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        socket.send(frames[i], i + 1 < count ? zmq::send_flags::sndmore : zmq::send_flags::none);
+    }
+}
+
+void ChunkedReply::releaseFrame(void*, void* hint) {
+    ChunkedReply* reply = static_cast<ChunkedReply*>(hint);
+    if (--reply->framesLeft_ == 0) {
+        delete reply;
+    }
+}
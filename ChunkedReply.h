@@ -0,0 +1,39 @@
+#ifndef CHUNKED_REPLY_H
+#define CHUNKED_REPLY_H
+
+#include <atomic>
+#include <memory>
+#include <msgpack.hpp>
+#include "cppzmq/zmq.hpp"
+
+// A large reply encoded into a list of fixed-size chunks rather than one
+// sbuffer, so encoding never reallocates and copies the payload so far.
+// Everything is copied into the chunks (no references to the caller's
+// strings), so the reply doesn't depend on the request's memory once
+// encoded.
+//
+// send() writes the chunks either as one frame, copied once into a message
+// of the exact size, or, for clients that asked for "multipart", as one
+// zero-copy frame per chunk. The frames of a multipart reply concatenate to
+// the same msgpack document as the single frame.
+class ChunkedReply {
+public:
+    explicit ChunkedReply(size_t chunkBytes);
+
+    msgpack::packer<msgpack::vrefbuffer>& packer() { return packer_; }
+    size_t size() const;
+
+    // Sends the payload frames; the caller has sent the routing frame with
+    // sndmore. A multipart reply is freed by ZeroMQ once its last frame has
+    // gone out.
+    static void send(zmq::socket_t& socket, std::unique_ptr<ChunkedReply> reply, bool multipart);
+
+private:
+    static void releaseFrame(void* data, void* hint);
+
+    msgpack::vrefbuffer buffer_;
+    msgpack::packer<msgpack::vrefbuffer> packer_;
+    std::atomic<size_t> framesLeft_{0};
+};
+
+#endif
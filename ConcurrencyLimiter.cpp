@@ -0,0 +1,141 @@
+#include "ConcurrencyLimiter.h"
+#include <algorithm>
+#include <cmath>
+
+// Samples per probe window; the no-load RTT is re-measured each window so it
+// follows the database when its baseline latency drifts. It may rise by at
+// most probeMaxRise per window, and not at all in a window where queueing
+// shrank the limit, so sustained overload can't pass itself off as the new
+// baseline.
+static const uint64_t probeWindowSamples = 5000;
+static const double probeMaxRise = 1.1;
+// Fewest samples in a round. Single RTTs vary with the query mix (a scan
+// next to point lookups), so the limit moves on round means instead.
+static const double minRoundSamples = 200;
+// Round RTT up to this multiple of the no-load RTT is still not queueing
+static const double rttTolerance = 1.5;
+
+ConcurrencyLimiter::ConcurrencyLimiter(int initialLimit, int minLimit, int maxLimit)
+    : minLimit_(std::max(1, minLimit)), maxLimit_(std::max(minLimit_, maxLimit)) {
+    limit_ = std::min(std::max(initialLimit, minLimit_), maxLimit_);
+}
+
+bool ConcurrencyLimiter::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t interrupts = interrupts_;
+    available_.wait(lock, [&] { return slots_ < static_cast<int>(limit_) || interrupts_ != interrupts; });
+    if (interrupts_ != interrupts) {
+        return false;
+    }
+    ++slots_;
+    return true;
+}
+
+void ConcurrencyLimiter::interrupt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++interrupts_;
+    }
+    available_.notify_all();
+}
+
+void ConcurrencyLimiter::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --slots_;
+    }
+    available_.notify_one();
+}
+
+std::chrono::steady_clock::time_point ConcurrencyLimiter::begin() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++running_;
+    return std::chrono::steady_clock::now();
+}
+
+void ConcurrencyLimiter::end(std::chrono::steady_clock::time_point started, bool dropped) {
+    double rttMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    bool grew;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int before = static_cast<int>(limit_);
+        update(rttMs, dropped);
+        --running_;
+        grew = static_cast<int>(limit_) > before;
+    }
+    if (grew) {
+        available_.notify_all();
+    }
+}
+
+void ConcurrencyLimiter::update(double rttMs, bool dropped) {
+    ++samples_;
+    rttMs_ = samples_ == 1 ? rttMs : rttMs_ + (rttMs - rttMs_) / 16;
+    roundSumMs_ += rttMs;
+    ++roundSamples_;
+
+    double step = std::max(1.0, std::log10(limit_));
+    if (dropped) {
+        limit_ -= step;
+    } else if (roundSamples_ >= std::max(minRoundSamples, limit_)) {
+        // Like Vegas, adjust once per round of queries rather than per sample
+        double roundMs = roundSumMs_ / roundSamples_;
+        windowSamples_ += roundSamples_;
+        roundSumMs_ = 0;
+        roundSamples_ = 0;
+        if (windowMinMs_ == 0 || roundMs < windowMinMs_) {
+            windowMinMs_ = roundMs;
+        }
+        if (rttNoLoadMs_ == 0 || roundMs < rttNoLoadMs_) {
+            rttNoLoadMs_ = roundMs;
+        }
+        if (windowSamples_ >= probeWindowSamples) {
+            if (!windowShrunk_) {
+                rttNoLoadMs_ = std::min(windowMinMs_, rttNoLoadMs_ * probeMaxRise);
+            }
+            windowMinMs_ = 0;
+            windowSamples_ = 0;
+            windowShrunk_ = false;
+        }
+
+        double queued = roundMs > 0 ? std::ceil(limit_ * (1 - rttTolerance * rttNoLoadMs_ / roundMs)) : 0;
+        double alpha = 3 * step;
+        double beta = 6 * step;
+        if (queued > beta) {
+            limit_ -= step;
+            windowShrunk_ = true;
+        } else if (running_ * 2 < limit_) {
+            // Not using the limit we have; no evidence that more would help
+        } else if (queued <= step) {
+            limit_ += beta;
+        } else if (queued < alpha) {
+            limit_ += step;
+        }
+    }
+    limit_ = std::min(std::max(limit_, static_cast<double>(minLimit_)), static_cast<double>(maxLimit_));
+}
+
+ConcurrencyLimiter::Stats ConcurrencyLimiter::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s;
+    s.limit = static_cast<int>(limit_);
+    s.inflight = running_;
+    s.rttNoLoadMs = rttNoLoadMs_;
+    s.rttMs = rttMs_;
+    s.samples = samples_;
+    return s;
+}
+
+int ConcurrencyLimiter::maxLimit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return maxLimit_;
+}
+
+void ConcurrencyLimiter::setMaxLimit(int maxLimit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxLimit_ = std::max(minLimit_, maxLimit);
+        limit_ = std::min(limit_, static_cast<double>(maxLimit_));
+    }
+    available_.notify_all();
+}
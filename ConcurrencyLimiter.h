@@ -0,0 +1,69 @@
+#ifndef CONCURRENCY_LIMITER_H
+#define CONCURRENCY_LIMITER_H
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+// Adaptive limit on how many requests the workers run against MySQL at once,
+// TCP Vegas style. The limiter measures RTT as the mean over a round of
+// queries, tracks the no-load RTT (the lowest round in the current probe
+// window) and estimates how many queries are queued inside the database as
+// limit * (1 - tolerance * rttNoLoad / rtt). Little queueing grows the limit,
+// much queueing or a timed-out query shrinks it, so concurrency settles just
+// below the point where MySQL starts thrashing.
+//
+// Workers take a slot before popping from the request scheduler, so work over
+// the limit stays in the scheduler queue where it can be ordered or shed.
+// Queries run while holding a slot are timed with begin()/end().
+class ConcurrencyLimiter {
+public:
+    struct Stats {
+        int limit;
+        int inflight;      // queries running now
+        double rttNoLoadMs;
+        double rttMs;      // smoothed
+        uint64_t samples;
+    };
+
+    ConcurrencyLimiter(int initialLimit, int minLimit, int maxLimit);
+
+    // Blocks until fewer than limit slots are taken and takes one. Returns
+    // false without a slot if interrupt() is called meanwhile.
+    bool acquire();
+    // Makes every blocked acquire() return false, so workers can check
+    // whether they should exit
+    void interrupt();
+    void release();
+    std::chrono::steady_clock::time_point begin();
+    // dropped: the query was killed for overrunning its deadline
+    void end(std::chrono::steady_clock::time_point started, bool dropped);
+    Stats stats();
+    int maxLimit();
+    // Clamps the current limit into the new bounds right away
+    void setMaxLimit(int maxLimit);
+
+private:
+    void update(double rttMs, bool dropped);
+
+private:
+    double limit_;
+    int minLimit_;
+    int maxLimit_;
+    int slots_ = 0;   // taken by workers
+    int running_ = 0; // between begin() and end()
+    double rttNoLoadMs_ = 0;
+    double windowMinMs_ = 0;
+    uint64_t windowSamples_ = 0;
+    bool windowShrunk_ = false; // queueing lowered the limit this window
+    double rttMs_ = 0;
+    double roundSumMs_ = 0; // samples since the limit was last adjusted
+    uint64_t roundSamples_ = 0;
+    uint64_t samples_ = 0;
+    uint64_t interrupts_ = 0;
+    std::mutex mutex_;
+    std::condition_variable available_;
+};
+
+#endif
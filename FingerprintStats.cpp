@@ -0,0 +1,96 @@
+#include "FingerprintStats.h"
+#include <algorithm>
+
+FingerprintStats::FingerprintStats(size_t maxEntries)
+    : maxPerStripe_(std::max<size_t>(1, maxEntries / stripeCount)) {
+}
+
+uint64_t FingerprintStats::Entry::p99Us() const {
+    uint64_t rank = calls - calls / 100;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen >= rank && seen > 0) {
+            return std::min(maxUs, metrics::Histogram::bucketUpperUs(static_cast<int>(b)));
+        }
+    }
+    return maxUs;
+}
+
+void FingerprintStats::record(uint64_t hash, const std::string& fingerprint, uint64_t latencyUs, uint64_t rows, uint64_t bytes, bool error) {
+    Stripe& stripe = stripes_[hash % stripeCount];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.entries.find(hash);
+    if (it == stripe.entries.end()) {
+        if (stripe.entries.size() >= maxPerStripe_) {
+            evict(stripe);
+        }
+        it = stripe.entries.emplace(hash, Entry()).first;
+        it->second.fingerprint = fingerprint;
+        it->second.buckets.assign(metrics::Histogram::bucketCount, 0);
+    }
+    Entry& entry = it->second;
+    ++entry.calls;
+    entry.errors += error ? 1 : 0;
+    entry.totalUs += latencyUs;
+    entry.maxUs = std::max(entry.maxUs, latencyUs);
+    entry.rows += rows;
+    entry.bytes += bytes;
+    ++entry.buckets[metrics::Histogram::bucketOf(latencyUs)];
+}
+
+void FingerprintStats::evict(Stripe& stripe) {
+    std::vector<std::pair<uint64_t, uint64_t>> byCalls; // (calls, hash)
+    byCalls.reserve(stripe.entries.size());
+    for (const auto& entry : stripe.entries) {
+        byCalls.emplace_back(entry.second.calls, entry.first);
+    }
+    size_t victims = std::max<size_t>(1, byCalls.size() / 20);
+    std::nth_element(byCalls.begin(), byCalls.begin() + (victims - 1), byCalls.end());
+    for (size_t i = 0; i < victims; ++i) {
+        stripe.entries.erase(byCalls[i].second);
+    }
+}
+
+std::vector<FingerprintStats::Entry> FingerprintStats::top(size_t n, Order order) {
+    std::vector<Entry> all;
+    for (Stripe& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        for (const auto& entry : stripe.entries) {
+            all.push_back(entry.second);
+        }
+    }
+    auto key = [order](const Entry& e) -> double {
+        switch (order) {
+            case Order::MeanTime: return e.meanUs();
+            case Order::P99: return static_cast<double>(e.p99Us());
+            case Order::Calls: return static_cast<double>(e.calls);
+            case Order::Errors: return static_cast<double>(e.errors);
+            case Order::Rows: return static_cast<double>(e.rows);
+            case Order::TotalTime: break;
+        }
+        return static_cast<double>(e.totalUs);
+    };
+    n = std::min(n, all.size());
+    std::partial_sort(all.begin(), all.begin() + n, all.end(), [&key](const Entry& a, const Entry& b) {
+        return key(a) > key(b);
+    });
+    all.resize(n);
+    return all;
+}
+
+void FingerprintStats::reset() {
+    for (Stripe& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        stripe.entries.clear();
+    }
+}
+
+size_t FingerprintStats::size() {
+    size_t total = 0;
+    for (Stripe& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        total += stripe.entries.size();
+    }
+    return total;
+}
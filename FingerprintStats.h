@@ -0,0 +1,56 @@
+#ifndef FINGERPRINT_STATS_H
+#define FINGERPRINT_STATS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "Metrics.h"
+
+// Per-statement-shape totals in the spirit of pg_stat_statements. Requests
+// are keyed by the hash of their fingerprint (statementFingerprint() for raw
+// SQL, the name for named queries). The table is split into lock stripes by
+// hash so workers rarely share a lock, and is bounded: when a stripe is full
+// the least-called 5% of its entries are evicted.
+class FingerprintStats {
+public:
+    struct Entry {
+        std::string fingerprint;
+        uint64_t calls = 0;
+        uint64_t errors = 0;
+        uint64_t totalUs = 0;
+        uint64_t maxUs = 0;
+        uint64_t rows = 0;
+        uint64_t bytes = 0;
+        double meanUs() const { return calls ? static_cast<double>(totalUs) / calls : 0; }
+        uint64_t p99Us() const;
+        // Latency distribution, metrics::Histogram buckets
+        std::vector<uint32_t> buckets;
+    };
+
+    enum class Order { TotalTime, MeanTime, P99, Calls, Errors, Rows };
+
+    explicit FingerprintStats(size_t maxEntries);
+
+    void record(uint64_t hash, const std::string& fingerprint, uint64_t latencyUs, uint64_t rows, uint64_t bytes, bool error);
+    // The n entries ranking highest by order
+    std::vector<Entry> top(size_t n, Order order);
+    void reset();
+    size_t size();
+
+private:
+    static const int stripeCount = 16;
+    struct Stripe {
+        std::unordered_map<uint64_t, Entry> entries;
+        std::mutex mutex;
+    };
+
+    void evict(Stripe& stripe);
+
+private:
+    size_t maxPerStripe_;
+    Stripe stripes_[stripeCount];
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "Logger.h"
+#include <iostream>
+#include <algorithm>
+#include <ctime>
+#include <cstdio>
+
+struct Logger::Ring {
+    static const size_t capacity = 1024;
+    Line lines[capacity];
+    std::atomic<size_t> head{0}; // next slot the owning thread writes
+    std::atomic<size_t> tail{0}; // next slot the writer thread reads
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> exited{false};
+    // Rate limiting, only touched by the owning thread
+    std::chrono::steady_clock::time_point windowStart;
+    int windowCount = 0;
+};
+
+namespace {
+
+    const char* levelName(LogLevel level) {
+        switch (level) {
+            case LogLevel::Debug: return "DEBUG";
+            case LogLevel::Info: return "INFO";
+            case LogLevel::Warn: return "WARN";
+            case LogLevel::Error: return "ERROR";
+        }
+        return "INFO";
+    }
+
+    // Quotes values that would otherwise be ambiguous in key=value output
+    void appendValue(std::string& out, const std::string& value) {
+        bool quote = value.empty() || value.find_first_of(" \"=\\\n\r\t") != std::string::npos;
+        if (!quote) {
+            out += value;
+            return;
+        }
+        out += '"';
+        for (char c : value) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default: out += c;
+            }
+        }
+        out += '"';
+    }
+
+    std::string timestamp(std::chrono::system_clock::time_point time) {
+        std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+        long millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+        std::tm utc;
+        gmtime_r(&seconds, &utc);
+        char buffer[32];
+        size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+        std::snprintf(buffer + length, sizeof(buffer) - length, ".%03ldZ", millis);
+        return buffer;
+    }
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() : writer_(&Logger::run, this) {
+}
+
+Logger::~Logger() {
+    stop_ = true;
+    writer_.join();
+}
+
+void Logger::configure(LogLevel minLevel, int ratePerSecond) {
+    minLevel_ = minLevel;
+    ratePerSecond_ = ratePerSecond;
+}
+
+bool Logger::parseLevel(const std::string& name, LogLevel& level) {
+    static const std::pair<const char*, LogLevel> levels[] = {
+        {"debug", LogLevel::Debug}, {"info", LogLevel::Info}, {"warn", LogLevel::Warn}, {"error", LogLevel::Error}};
+    for (const auto& entry : levels) {
+        if (name == entry.first) {
+            level = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+Logger::Ring& Logger::threadRing() {
+    // Marks the ring when its thread exits so the writer can remove it once drained
+    struct Holder {
+        std::shared_ptr<Ring> ring;
+        ~Holder() {
+            if (ring) {
+                ring->exited.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Holder holder;
+    if (!holder.ring) {
+        holder.ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings_.push_back(holder.ring);
+    }
+    return *holder.ring;
+}
+
+void Logger::log(LogLevel level, const std::string& message, std::initializer_list<LogField> fields) {
+    if (!enabled(level)) {
+        return;
+    }
+    Ring& ring = threadRing();
+
+    int rate = ratePerSecond_.load(std::memory_order_relaxed);
+    if (rate > 0) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - ring.windowStart >= std::chrono::seconds(1)) {
+            ring.windowStart = now;
+            ring.windowCount = 0;
+        }
+        if (ring.windowCount >= rate) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ++ring.windowCount;
+    }
+
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= Ring::capacity) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Line& line = ring.lines[head % Ring::capacity];
+    line.level = level;
+    line.time = std::chrono::system_clock::now();
+    line.text.assign(message);
+    for (const LogField& field : fields) {
+        line.text += ' ';
+        line.text += field.key;
+        line.text += '=';
+        appendValue(line.text, field.value);
+    }
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t Logger::dropped() const {
+    uint64_t total = exitedDrops_.load();
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (const auto& ring : rings_) {
+        total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Logger::drain(std::vector<Line>& out) {
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings = rings_;
+    }
+    bool anyExited = false;
+    for (const auto& ring : rings) {
+        // Checked before reading so lines logged before the thread exited are drained
+        bool exited = ring->exited.load(std::memory_order_acquire);
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            Line& line = ring->lines[tail % Ring::capacity];
+            out.push_back(Line{line.level, line.time, std::move(line.text)});
+        }
+        ring->tail.store(head, std::memory_order_release);
+        anyExited = anyExited || exited;
+    }
+    if (!anyExited) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (auto it = rings_.begin(); it != rings_.end();) {
+        Ring& ring = **it;
+        if (ring.exited.load(std::memory_order_acquire) && ring.head.load() == ring.tail.load()) {
+            exitedDrops_ += ring.dropped.load();
+            it = rings_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Logger::write(std::vector<Line>& lines) {
+    std::stable_sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) { return a.time < b.time; });
+    bool wroteOut = false;
+    bool wroteErr = false;
+    for (const Line& line : lines) {
+        bool toErr = line.level >= LogLevel::Warn;
+        (toErr ? std::cerr : std::cout) << timestamp(line.time) << ' ' << levelName(line.level) << ' ' << line.text << '\n';
+        wroteOut = wroteOut || !toErr;
+        wroteErr = wroteErr || toErr;
+    }
+    uint64_t drops = dropped();
+    if (drops > reportedDrops_) {
+        std::cerr << timestamp(std::chrono::system_clock::now()) << " WARN Dropped log lines (rate limit or full buffer) count="
+                  << drops - reportedDrops_ << '\n';
+        reportedDrops_ = drops;
+        wroteErr = true;
+    }
+    if (wroteOut) {
+        std::cout.flush();
+    }
+    if (wroteErr) {
+        std::cerr.flush();
+    }
+}
+
+void Logger::flush() {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    std::vector<Line> lines;
+    drain(lines);
+    write(lines);
+}
+
+void Logger::run() {
+    while (!stop_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        flush();
+    }
+    flush();
+}
@@ -0,0 +1,77 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <initializer_list>
+
+enum class LogLevel { Debug, Info, Warn, Error };
+
+// A key=value pair appended to a log line, e.g. {"query_id", queryId}
+struct LogField {
+    const char* key;
+    std::string value;
+};
+
+// Asynchronous logger for worker threads. Each thread formats its message
+// and pushes it into its own single-producer ring buffer; a background
+// thread drains the rings every few milliseconds, orders the lines by time
+// and writes warnings and errors to stderr, the rest to stdout.
+//
+// Logging never waits: a line is dropped when its thread has used up its
+// per-second budget or its ring is full, and the writer reports how many
+// were dropped. Only a thread's first message takes a lock, to register
+// its ring.
+//
+// Lines look like
+//   2026-01-31T12:00:00.123Z ERROR SQL error query_id=42 fingerprint="SELECT ?"
+class Logger {
+public:
+    static Logger& instance();
+
+    // ratePerSecond: lines each thread may log per second; 0 for no limit
+    void configure(LogLevel minLevel, int ratePerSecond);
+    bool enabled(LogLevel level) const { return level >= minLevel_.load(std::memory_order_relaxed); }
+    void log(LogLevel level, const std::string& message, std::initializer_list<LogField> fields = {});
+    // Lines dropped so far by rate limiting or full rings
+    uint64_t dropped() const;
+    // Writes everything logged so far before returning
+    void flush();
+
+    // "debug", "info", "warn" or "error"
+    static bool parseLevel(const std::string& name, LogLevel& level);
+
+private:
+    struct Line {
+        LogLevel level;
+        std::chrono::system_clock::time_point time;
+        std::string text;
+    };
+    struct Ring;
+
+    Logger();
+    ~Logger();
+    Ring& threadRing();
+    void run();
+    // Moves every queued line to out, removing rings of exited threads
+    void drain(std::vector<Line>& out);
+    void write(std::vector<Line>& lines);
+
+private:
+    std::atomic<LogLevel> minLevel_{LogLevel::Info};
+    std::atomic<int> ratePerSecond_{200};
+    std::vector<std::shared_ptr<Ring>> rings_;
+    mutable std::mutex ringsMutex_;
+    std::mutex writeMutex_; // serializes the writer thread and flush()
+    uint64_t reportedDrops_ = 0;
+    std::atomic<uint64_t> exitedDrops_{0}; // drops counted by removed rings
+    std::atomic<bool> stop_{false};
+    std::thread writer_;
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "LookupCoalescer.h"
+#include <cppconn/resultset.h>
+#include <cppconn/resultset_metadata.h>
+#include <cppconn/datatype.h>
+#include <cppconn/exception.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "Logger.h"
+#include <unordered_map>
+
+namespace {
+
+    bool isNumeric(int columnType) {
+        switch (columnType) {
+            case sql::DataType::TINYINT:
+            case sql::DataType::SMALLINT:
+            case sql::DataType::MEDIUMINT:
+            case sql::DataType::INTEGER:
+            case sql::DataType::BIGINT:
+            case sql::DataType::REAL:
+            case sql::DataType::DOUBLE:
+            case sql::DataType::DECIMAL:
+            case sql::DataType::NUMERIC:
+            case sql::DataType::YEAR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // A key as MySQL compares it with the key column: numerically for
+    // numeric columns, so 42, "042" and 42.0 are one key, and otherwise
+    // ignoring ASCII case and trailing spaces like the default _ci
+    // collations. Keys the IN query matched by rules beyond these (accents,
+    // other collations) come back as rows that match no lookup.
+    std::string normalizeKey(const std::string& text, int columnType) {
+        if (isNumeric(columnType)) {
+            const char* start = text.c_str();
+            char* end = nullptr;
+            long double value = std::strtold(start, &end);
+            while (end != start && std::isspace(static_cast<unsigned char>(*end))) {
+                ++end;
+            }
+            if (end != start && *end == '\0') {
+                char normalized[64];
+                std::snprintf(normalized, sizeof(normalized), "%.21Lg", value);
+                return normalized;
+            }
+            return text;
+        }
+        std::string normalized = text;
+        normalized.erase(normalized.find_last_not_of(' ') + 1);
+        for (char& c : normalized) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return normalized;
+    }
+}
+
+LookupCoalescer::LookupCoalescer(MySQLConnectionPool& pool, QueryWatchdog& watchdog, const QueryRegistry& registry)
+    : pool_(pool), watchdog_(watchdog), open_(registry.queries().size()) {
+}
+
+void LookupCoalescer::submit(const NamedQuery& query, const QueryParam& key, int bulkhead,
+                             std::chrono::steady_clock::time_point deadline, Completion done) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++lookups_;
+    std::shared_ptr<Batch>& open = open_[query.index];
+    bool leader = !open;
+    if (leader) {
+        open = std::make_shared<Batch>();
+        open->lookups.reserve(query.coalesceMaxBatch);
+    }
+    std::shared_ptr<Batch> batch = open;
+    batch->lookups.push_back(Lookup{key, paramText(key), deadline, std::move(done)});
+    if (batch->lookups.size() >= query.coalesceMaxBatch) {
+        // Full: close it so the next lookup starts a new batch
+        open.reset();
+        batch->full.notify_one();
+    }
+    if (!leader) {
+        return;
+    }
+
+    auto windowEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(query.coalesceWindowUs);
+    batch->full.wait_until(lock, windowEnd, [&] {
+        return batch->lookups.size() >= query.coalesceMaxBatch;
+    });
+    if (open_[query.index] == batch) {
+        open_[query.index].reset();
+    }
+    ++batches_;
+    lock.unlock();
+
+    execute(query, *batch, bulkhead);
+}
+
+LookupCoalescer::Stats LookupCoalescer::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s;
+    s.lookups = lookups_;
+    s.batches = batches_;
+    s.avgBatchSize = batches_ ? static_cast<double>(lookups_) / batches_ : 0;
+    return s;
+}
+
+void LookupCoalescer::execute(const NamedQuery& query, Batch& batch, int bulkhead) {
+    // Distinct keys, in arrival order. The batch may run until no lookup in
+    // it can use the reply any more.
+    std::vector<const QueryParam*> keys;
+    std::unordered_map<std::string, Rows> rowsByKey;
+    auto deadline = std::chrono::steady_clock::time_point::min();
+    for (const Lookup& lookup : batch.lookups) {
+        if (rowsByKey.emplace(lookup.keyText, Rows()).second) {
+            keys.push_back(&lookup.key);
+        }
+        bool hasDeadline = lookup.deadline != std::chrono::steady_clock::time_point();
+        deadline = std::max(deadline, hasDeadline ? lookup.deadline : std::chrono::steady_clock::time_point::max());
+    }
+
+    // Smallest prepared IN statement that fits; spare placeholders repeat the
+    // last key, which doesn't change the result.
+    size_t placeholders = 0;
+    size_t statementIndex = 0;
+    for (const auto& statement : query.coalesceStatements) {
+        placeholders = statement.first;
+        statementIndex = statement.second;
+        if (placeholders >= keys.size()) {
+            break;
+        }
+    }
+
+    Result result;
+    Timing& timing = result.timing;
+    sql::Connection* conn = nullptr;
+    uint64_t watchToken = 0;
+    try {
+        timing.acquireStart = std::chrono::steady_clock::now();
+        conn = pool_.getConnection(bulkhead);
+        timing.executeStart = std::chrono::steady_clock::now();
+        sql::PreparedStatement* stmt = pool_.getPreparedStatement(conn, statementIndex);
+        std::vector<QueryParam> params;
+        params.reserve(placeholders);
+        for (size_t i = 0; i < placeholders; ++i) {
+            params.push_back(*keys[std::min(i, keys.size() - 1)]);
+        }
+        bindParams(*stmt, params);
+        // Watched under no client: cancelling one lookup must not kill the
+        // batch the others are waiting on
+        watchToken = watchdog_.begin("", "", pool_.getConnectionId(conn), deadline);
+        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery());
+        watchdog_.end(watchToken);
+        watchToken = 0;
+        timing.fetchStart = std::chrono::steady_clock::now();
+
+        sql::ResultSetMetaData* meta = res->getMetaData();
+        unsigned int columnCount = meta->getColumnCount();
+        std::vector<std::string> columns;
+        unsigned int keyColumn = 0;
+        for (unsigned int i = 1; i <= columnCount; ++i) {
+            columns.push_back(meta->getColumnLabel(i));
+            if (columns.back() == query.coalesceKey) {
+                keyColumn = i;
+            }
+        }
+        if (keyColumn == 0) {
+            throw std::runtime_error("Coalesced query " + query.name + " does not select key column " + query.coalesceKey);
+        }
+        // Requested keys that compare equal in the key column's type share rows
+        int keyType = meta->getColumnType(keyColumn);
+        std::unordered_map<std::string, std::vector<Rows*>> requesters;
+        for (auto& entry : rowsByKey) {
+            requesters[normalizeKey(entry.first, keyType)].push_back(&entry.second);
+        }
+        uint64_t unmatched = 0;
+        while (res->next()) {
+            auto it = requesters.find(normalizeKey(res->getString(keyColumn), keyType));
+            if (it == requesters.end()) {
+                ++unmatched;
+                continue;
+            }
+            std::map<std::string, std::string> row;
+            for (unsigned int i = 1; i <= columnCount; ++i) {
+                row[columns[i - 1]] = res->getString(i);
+            }
+            for (size_t i = 1; i < it->second.size(); ++i) {
+                it->second[i]->push_back(row);
+            }
+            it->second[0]->push_back(std::move(row));
+        }
+        if (unmatched > 0) {
+            Logger::instance().log(LogLevel::Warn, "Coalesced lookup rows matched no requested key",
+                                   {{"fingerprint", query.name}, {"rows", std::to_string(unmatched)}});
+        }
+        timing.fetchEnd = std::chrono::steady_clock::now();
+    } catch (const std::exception &e) {
+        if (watchToken != 0) {
+            result.killed = watchdog_.end(watchToken);
+        }
+        if (result.killed == QueryWatchdog::Outcome::None) {
+            Logger::instance().log(LogLevel::Error, "Coalesced lookup failed", {{"fingerprint", query.name}, {"error", e.what()}});
+        }
+        result.error = e.what();
+    }
+    if (conn) {
+        pool_.releaseConnection(conn, bulkhead);
+    }
+
+    static const Rows noRows;
+    for (Lookup& lookup : batch.lookups) {
+        lookup.done(result.error.empty() ? rowsByKey[lookup.keyText] : noRows, result);
+    }
+}
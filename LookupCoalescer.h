@@ -0,0 +1,84 @@
+#ifndef LOOKUP_COALESCER_H
+#define LOOKUP_COALESCER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "mySQLConnectionPool.h"
+#include "QueryRegistry.h"
+#include "QueryWatchdog.h"
+
+// Merges concurrent single-key lookups of the same named query into one
+// "WHERE key IN (...)" query, data-loader style. The first lookup of a batch
+// becomes its leader: it waits up to the query's window (or until the batch
+// is full), runs the IN query on one pooled connection and hands each
+// requester the rows whose key column matches its key. Later lookups just
+// join the batch and return immediately.
+//
+// A batch runs like any other query: on a connection from the leader's
+// bulkhead budget, under the query watchdog until the last deadline among
+// its lookups, and each requester gets the batch's stage times so its reply
+// is accounted like one it ran itself.
+class LookupCoalescer {
+public:
+    typedef std::vector<std::map<std::string, std::string>> Rows;
+
+    // Stage boundaries of a batch; zero for stages it didn't reach
+    struct Timing {
+        std::chrono::steady_clock::time_point acquireStart;
+        std::chrono::steady_clock::time_point executeStart; // connection acquired
+        std::chrono::steady_clock::time_point fetchStart;   // IN query returned
+        std::chrono::steady_clock::time_point fetchEnd;
+    };
+    struct Result {
+        std::string error; // empty on success
+        QueryWatchdog::Outcome killed = QueryWatchdog::Outcome::None;
+        Timing timing;
+    };
+    typedef std::function<void(const Rows& rows, const Result& result)> Completion;
+
+    struct Stats {
+        uint64_t lookups;
+        uint64_t batches;
+        double avgBatchSize;
+    };
+
+    LookupCoalescer(MySQLConnectionPool& pool, QueryWatchdog& watchdog, const QueryRegistry& registry);
+
+    // query must have coalesce set. Blocks only when this call leads the
+    // batch, which then runs in this lookup's bulkhead. deadline is zero
+    // when the lookup has none.
+    void submit(const NamedQuery& query, const QueryParam& key, int bulkhead,
+                std::chrono::steady_clock::time_point deadline, Completion done);
+    Stats stats();
+
+private:
+    struct Lookup {
+        QueryParam key;
+        std::string keyText;
+        std::chrono::steady_clock::time_point deadline;
+        Completion done;
+    };
+    struct Batch {
+        std::vector<Lookup> lookups;
+        std::condition_variable full;
+    };
+
+    void execute(const NamedQuery& query, Batch& batch, int bulkhead);
+
+private:
+    MySQLConnectionPool& pool_;
+    QueryWatchdog& watchdog_;
+    std::vector<std::shared_ptr<Batch>> open_; // open batch per registry index
+    std::mutex mutex_;
+    uint64_t lookups_ = 0;
+    uint64_t batches_ = 0;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "Metrics.h"
+#include <sstream>
+#include <iomanip>
+
+namespace metrics {
+
+int threadShard() {
+    static std::atomic<int> next{0};
+    thread_local int shard = next.fetch_add(1, std::memory_order_relaxed) % shardCount;
+    return shard;
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const Shard& shard : shards_) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram::Histogram() : shards_(new Shard[shardCount]) {
+    for (int s = 0; s < shardCount; ++s) {
+        for (std::atomic<uint64_t>& count : shards_[s].counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+int Histogram::bucketOf(uint64_t us) {
+    if (us < static_cast<uint64_t>(subBuckets)) {
+        return static_cast<int>(us);
+    }
+    int exponent = 63 - __builtin_clzll(us); // >= 2
+    int sub = static_cast<int>((us >> (exponent - 2)) & (subBuckets - 1));
+    int bucket = subBuckets + (exponent - 2) * subBuckets + sub;
+    return bucket < bucketCount ? bucket : bucketCount - 1;
+}
+
+uint64_t Histogram::bucketUpperUs(int bucket) {
+    if (bucket < subBuckets) {
+        return static_cast<uint64_t>(bucket);
+    }
+    int exponent = (bucket - subBuckets) / subBuckets + 2;
+    int sub = (bucket - subBuckets) % subBuckets;
+    return ((static_cast<uint64_t>(subBuckets + sub + 1)) << (exponent - 2)) - 1;
+}
+
+void Histogram::record(uint64_t us) {
+    Shard& shard = shards_[threadShard()];
+    shard.counts[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    shard.sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot result;
+    result.counts.assign(bucketCount, 0);
+    for (int s = 0; s < shardCount; ++s) {
+        for (int b = 0; b < bucketCount; ++b) {
+            uint64_t n = shards_[s].counts[b].load(std::memory_order_relaxed);
+            result.counts[b] += n;
+            result.count += n;
+        }
+        result.sumUs += shards_[s].sumUs.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+uint64_t Histogram::Snapshot::quantileUs(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * count);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); ++b) {
+        seen += counts[b];
+        if (seen > rank) {
+            return bucketUpperUs(static_cast<int>(b));
+        }
+    }
+    return bucketUpperUs(bucketCount - 1);
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_.emplace_back();
+    Entry entry;
+    entry.type = Type::Counter;
+    entry.name = name;
+    entry.help = help;
+    entry.counter = &counters_.back();
+    entries_.push_back(entry);
+    return counters_.back();
+}
+
+Histogram& Registry::histogram(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    histograms_.emplace_back();
+    Entry entry;
+    entry.type = Type::Histogram;
+    entry.name = name;
+    entry.help = help;
+    entry.labels = labels;
+    entry.histogram = &histograms_.back();
+    entries_.push_back(entry);
+    return histograms_.back();
+}
+
+void Registry::gauge(const std::string& name, const std::string& help, std::function<double()> fn, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry entry;
+    entry.type = Type::Gauge;
+    entry.name = name;
+    entry.help = help;
+    entry.labels = labels;
+    entry.gauge = fn;
+    entries_.push_back(entry);
+}
+
+namespace {
+
+// "{a="b",le="0.5"}" from the entry labels plus one extra label
+std::string labelSet(const std::string& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) {
+        return "";
+    }
+    return "{" + labels + (labels.empty() || extra.empty() ? "" : ",") + extra + "}";
+}
+
+std::string seconds(uint64_t us) {
+    std::ostringstream out;
+    out << std::setprecision(9) << static_cast<double>(us) / 1e6;
+    return out.str();
+}
+
+}
+
+std::string Registry::prometheus() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream out;
+    std::string lastName;
+    for (const Entry& entry : entries_) {
+        // HELP and TYPE once per family; entries of a family are registered together
+        if (entry.name != lastName) {
+            const char* type = entry.type == Type::Counter ? "counter" : entry.type == Type::Histogram ? "histogram" : "gauge";
+            out << "# HELP " << entry.name << " " << entry.help << "\n";
+            out << "# TYPE " << entry.name << " " << type << "\n";
+            lastName = entry.name;
+        }
+        if (entry.type == Type::Counter) {
+            out << entry.name << labelSet(entry.labels) << " " << entry.counter->value() << "\n";
+        } else if (entry.type == Type::Gauge) {
+            out << entry.name << labelSet(entry.labels) << " " << entry.gauge() << "\n";
+        } else {
+            // Histograms are recorded in microseconds and exported in seconds
+            Histogram::Snapshot snapshot = entry.histogram->snapshot();
+            uint64_t cumulative = 0;
+            for (int b = 0; b < Histogram::bucketCount; ++b) {
+                cumulative += snapshot.counts[b];
+                out << entry.name << "_bucket" << labelSet(entry.labels, "le=\"" + seconds(Histogram::bucketUpperUs(b)) + "\"")
+                    << " " << cumulative << "\n";
+            }
+            out << entry.name << "_bucket" << labelSet(entry.labels, "le=\"+Inf\"") << " " << snapshot.count << "\n";
+            out << entry.name << "_sum" << labelSet(entry.labels) << " " << seconds(snapshot.sumUs) << "\n";
+            out << entry.name << "_count" << labelSet(entry.labels) << " " << snapshot.count << "\n";
+        }
+    }
+    return out.str();
+}
+
+}
@@ -0,0 +1,106 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+// Counters and histograms written by many threads without locks: each
+// thread adds into its own cache-line-sized shard and readers sum the
+// shards, so workers never contend on a metric.
+namespace metrics {
+
+const int shardCount = 16;
+
+// Shard of the calling thread, assigned round robin on first use
+int threadShard();
+
+class Counter {
+public:
+    void add(uint64_t n = 1) {
+        shards_[threadShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const;
+
+private:
+    // Padded rather than alignas(64): C++14 new ignores extended alignment,
+    // and a 64-byte stride keeps each value on its own cache line anyway
+    struct Shard {
+        std::atomic<uint64_t> value{0};
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    Shard shards_[shardCount];
+};
+
+// HDR-style log-linear histogram of microsecond values: every power of two
+// is split into 4 linear sub-buckets, so any recorded value is within 25% of
+// its bucket bound, from 1 us up to about an hour.
+class Histogram {
+public:
+    static const int subBuckets = 4;
+    static const int bucketCount = subBuckets + 30 * subBuckets;
+
+    struct Snapshot {
+        std::vector<uint64_t> counts; // per bucket, not cumulative
+        uint64_t count = 0;
+        uint64_t sumUs = 0;
+        // Upper bound, in microseconds, of the bucket holding quantile q
+        uint64_t quantileUs(double q) const;
+    };
+
+    Histogram();
+    void record(uint64_t us);
+    Snapshot snapshot() const;
+
+    static int bucketOf(uint64_t us);
+    // Largest value that falls in bucket
+    static uint64_t bucketUpperUs(int bucket);
+
+private:
+    // Shards are ~1 KB, so only their edges can share a cache line
+    struct Shard {
+        std::atomic<uint64_t> counts[bucketCount];
+        std::atomic<uint64_t> sumUs{0};
+    };
+    std::unique_ptr<Shard[]> shards_;
+};
+
+// Named metrics rendered in the Prometheus text format. Metrics are
+// registered at startup and live as long as the registry; a histogram or
+// gauge name may be registered several times with different labels, e.g.
+// stage="execute".
+class Registry {
+public:
+    Counter& counter(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "");
+    // fn is called on every scrape
+    void gauge(const std::string& name, const std::string& help, std::function<double()> fn, const std::string& labels = "");
+
+    std::string prometheus() const;
+
+private:
+    enum class Type { Counter, Histogram, Gauge };
+    struct Entry {
+        Type type;
+        std::string name;
+        std::string help;
+        std::string labels;
+        Counter* counter = nullptr;
+        Histogram* histogram = nullptr;
+        std::function<double()> gauge;
+    };
+
+    std::deque<Counter> counters_;
+    std::deque<Histogram> histograms_;
+    std::vector<Entry> entries_;
+    mutable std::mutex mutex_;
+};
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "MetricsServer.h"
+#include <iostream>
+
+MetricsServer::MetricsServer(zmq::context_t& context, const std::string& endpoint, const metrics::Registry& registry)
+    : socket_(context, ZMQ_STREAM), endpoint_(endpoint), registry_(registry) {
+}
+
+MetricsServer::~MetricsServer() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void MetricsServer::start() {
+    socket_.set(zmq::sockopt::rcvtimeo, 200); // lets serve() notice shutdown
+    socket_.set(zmq::sockopt::linger, 0);
+    socket_.bind(endpoint_);
+    running_ = true;
+    thread_ = std::thread([this]() {
+        serve();
+    });
+    std::cout << "Metrics are served on " << endpoint_ << "/metrics" << std::endl;
+}
+
+void MetricsServer::serve() {
+    while (running_) {
+        zmq::message_t peer;
+        zmq::message_t data;
+        if (!socket_.recv(peer, zmq::recv_flags::none)) {
+            continue;
+        }
+        if (!socket_.recv(data, zmq::recv_flags::none) || data.size() == 0) {
+            continue; // connect or disconnect notification
+        }
+        std::string peerId = peer.to_string();
+        std::string response = respond(data.to_string());
+        socket_.send(zmq::buffer(peerId), zmq::send_flags::sndmore);
+        socket_.send(zmq::buffer(response), zmq::send_flags::none);
+        // An empty frame closes the connection
+        socket_.send(zmq::buffer(peerId), zmq::send_flags::sndmore);
+        socket_.send(zmq::message_t(), zmq::send_flags::none);
+    }
+}
+
+std::string MetricsServer::respond(const std::string& request) {
+    std::string status = "200 OK";
+    std::string body;
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0) {
+        body = registry_.prometheus();
+    } else {
+        status = "404 Not Found";
+        body = "Not found\n";
+    }
+    return "HTTP/1.1 " + status + "\r\n"
+           "Content-Type: text/plain; version=0.0.4\r\n"
+           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+           "Connection: close\r\n\r\n" + body;
+}
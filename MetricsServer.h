@@ -0,0 +1,33 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include "cppzmq/zmq.hpp"
+#include "Metrics.h"
+
+// Minimal HTTP listener serving registry.prometheus() on GET /metrics, built
+// on a ZMQ_STREAM socket so it needs nothing beyond ZeroMQ. One response
+// per connection; requests are expected to fit in one read, which holds for
+// scrapers.
+class MetricsServer {
+public:
+    MetricsServer(zmq::context_t& context, const std::string& endpoint, const metrics::Registry& registry);
+    ~MetricsServer();
+
+    void start();
+
+private:
+    void serve();
+    std::string respond(const std::string& request);
+
+private:
+    zmq::socket_t socket_;
+    std::string endpoint_;
+    const metrics::Registry& registry_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+};
+
+#endif
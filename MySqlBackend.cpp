@@ -0,0 +1,146 @@
+#include "MySqlBackend.h"
+#include "SqlStatement.h"
+#include <cppconn/statement.h>
+#include <cppconn/resultset.h>
+#include <cppconn/resultset_metadata.h>
+#include <cppconn/prepared_statement.h>
+#include <chrono>
+
+namespace {
+
+    // The driver only asks the server for the warning texts when the
+    // statement's OK packet reported any
+    uint64_t countWarnings(const sql::SQLWarning* warning) {
+        uint64_t count = 0;
+        for (; warning; warning = warning->getNextWarning()) {
+            ++count;
+        }
+        return count;
+    }
+
+    bool isInsert(const std::string& sql) {
+        std::string keyword = leadingKeyword(sql);
+        return keyword == "INSERT" || keyword == "REPLACE";
+    }
+
+    class MySqlSession : public QuerySession {
+    public:
+        MySqlSession(MySQLConnectionPool& pool, int bulkhead)
+            : pool_(pool), bulkhead_(bulkhead) {
+            conn_ = pool_.getConnection(bulkhead_);
+        }
+
+        ~MySqlSession() override {
+            // Statements and results must go before their connection does
+            res_.reset();
+            stmt_.reset();
+            pool_.releaseConnection(conn_, bulkhead_);
+        }
+
+        uint64_t connectionId() override {
+            return pool_.getConnectionId(conn_);
+        }
+
+        // Writes go through executeUpdate and reply with counters instead of
+        // an (empty) result set.
+        bool execute(const Request& request, const NamedQuery* named) override {
+            if (named) {
+                // Prepared once per connection by the pool; only bind and run here
+                sql::PreparedStatement* prepared = pool_.getPreparedStatement(conn_, named->index);
+                bindParams(*prepared, request.params);
+                if (named->kind == StatementKind::Query) {
+                    res_.reset(prepared->executeQuery());
+                } else if (named->kind == StatementKind::Update) {
+                    affectedRows_ = prepared->executeUpdate();
+                } else if (prepared->execute()) {
+                    res_.reset(prepared->getResultSet());
+                } else {
+                    affectedRows_ = prepared->getUpdateCount();
+                }
+                if (!res_) {
+                    insert_ = isInsert(named->sql);
+                    warnings_ = countWarnings(prepared->getWarnings());
+                }
+                return res_ != nullptr;
+            }
+
+            const std::string& query = request.query;
+            stmt_.reset(conn_->createStatement());
+            StatementKind kind = classifyStatement(query);
+            if (kind == StatementKind::Query) {
+                // The hint lets MySQL abort a SELECT on its own before the watchdog kills it
+                bool hasDeadline = request.deadline != std::chrono::steady_clock::time_point();
+                long long remainingMs = hasDeadline ? std::chrono::duration_cast<std::chrono::milliseconds>(
+                    request.deadline - std::chrono::steady_clock::now()).count() : 0;
+                res_.reset(stmt_->executeQuery(hasDeadline ? withMaxExecutionTime(query, remainingMs) : query));
+            } else if (kind == StatementKind::Update) {
+                affectedRows_ = stmt_->executeUpdate(query);
+            } else if (stmt_->execute(query)) {
+                res_.reset(stmt_->getResultSet());
+            } else {
+                affectedRows_ = stmt_->getUpdateCount();
+            }
+            if (!res_) {
+                insert_ = isInsert(query);
+                warnings_ = countWarnings(stmt_->getWarnings());
+            }
+            return res_ != nullptr;
+        }
+
+        void fetch(ResultRows& rows) override {
+            // Labels are read once per result set, not once per cell
+            sql::ResultSetMetaData* meta = res_->getMetaData();
+            unsigned int columnCount = meta->getColumnCount();
+            std::pmr::vector<std::pmr::string> labels(rows.get_allocator());
+            labels.reserve(columnCount);
+            for (unsigned int i = 1; i <= columnCount; ++i) {
+                sql::SQLString label = meta->getColumnLabel(i);
+                labels.emplace_back(label.c_str(), label.length());
+            }
+            while (res_->next()) {
+                auto& row = rows.emplace_back();
+                for (unsigned int i = 1; i <= columnCount; ++i) {
+                    sql::SQLString value = res_->getString(i);
+                    row.emplace(labels[i - 1], std::string_view(value.c_str(), value.length()));
+                }
+            }
+        }
+
+        // Only an INSERT or REPLACE that wrote rows reports an id. The driver
+        // doesn't expose the id from the OK packet, so it is read back with
+        // LAST_INSERT_ID() and reset to 0 in the same query: the value is kept
+        // per connection, and the next insert on this pooled connection that
+        // generates no id must not see this one.
+        UpdateCounts updateCounts() override {
+            UpdateCounts counts;
+            counts.affectedRows = affectedRows_;
+            counts.warnings = warnings_;
+            if (insert_ && affectedRows_ > 0) {
+                std::unique_ptr<sql::Statement> stmt(conn_->createStatement());
+                std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT LAST_INSERT_ID(), LAST_INSERT_ID(0)"));
+                if (res->next()) {
+                    counts.lastInsertId = res->getUInt64(1);
+                }
+            }
+            return counts;
+        }
+
+    private:
+        MySQLConnectionPool& pool_;
+        int bulkhead_;
+        sql::Connection* conn_;
+        std::unique_ptr<sql::Statement> stmt_;
+        std::unique_ptr<sql::ResultSet> res_;
+        uint64_t affectedRows_ = 0;
+        uint64_t warnings_ = 0;
+        bool insert_ = false;
+    };
+}
+
+MySqlBackend::MySqlBackend(MySQLConnectionPool& pool)
+    : pool_(pool) {
+}
+
+std::unique_ptr<QuerySession> MySqlBackend::open(int bulkhead) {
+    return std::unique_ptr<QuerySession>(new MySqlSession(pool_, bulkhead));
+}
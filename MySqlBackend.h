@@ -0,0 +1,20 @@
+#ifndef MYSQL_BACKEND_H
+#define MYSQL_BACKEND_H
+
+#include "QueryBackend.h"
+#include "mySQLConnectionPool.h"
+
+// Runs queries on pooled MySQL connections. Named queries use the
+// statements the pool prepared on each connection; raw SELECTs with a
+// deadline carry a MAX_EXECUTION_TIME hint.
+class MySqlBackend : public QueryBackend {
+public:
+    explicit MySqlBackend(MySQLConnectionPool& pool);
+
+    std::unique_ptr<QuerySession> open(int bulkhead) override;
+
+private:
+    MySQLConnectionPool& pool_;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef QUERY_BACKEND_H
+#define QUERY_BACKEND_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
+#include "Request.h"
+#include "QueryRegistry.h"
+
+// A result set as it is sent to clients: column label -> value, per row.
+// Allocated from the worker's RequestArena (see WorkerMemory.h); rows and
+// strings added to it take its memory resource.
+typedef std::pmr::vector<std::pmr::map<std::pmr::string, std::pmr::string>> ResultRows;
+
+// What a statement that returns no rows replies with
+struct UpdateCounts {
+    uint64_t affectedRows = 0;
+    uint64_t lastInsertId = 0;
+    uint64_t warnings = 0;
+};
+
+// A connection checked out for one request, returned when destroyed
+class QuerySession {
+public:
+    virtual ~QuerySession() {}
+
+    // Id the query watchdog can KILL QUERY; 0 when queries can't be killed
+    virtual uint64_t connectionId() = 0;
+    // Runs the named query, or request.query when named is null, within
+    // request.deadline if one is set. True when the statement returned rows.
+    virtual bool execute(const Request& request, const NamedQuery* named) = 0;
+    // Appends the rows, after execute() returned true
+    virtual void fetch(ResultRows& rows) = 0;
+    // After execute() returned false
+    virtual UpdateCounts updateCounts() = 0;
+};
+
+// Where handleRequest runs queries: MySQL through the connection pool
+// (MySqlBackend) or made-up rows for benchmarking without a database
+// (SyntheticBackend).
+class QueryBackend {
+public:
+    virtual ~QueryBackend() {}
+
+    // A session for one request in the given bulkhead; MySqlBackend blocks
+    // while the bulkhead's connection budget is used up
+    virtual std::unique_ptr<QuerySession> open(int bulkhead) = 0;
+};
+
+#endif
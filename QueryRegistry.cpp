@@ -0,0 +1,162 @@
+#include "QueryRegistry.h"
+#include "nlohmann/json.hpp"
+#include <cppconn/datatype.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using json = nlohmann::json;
+
+QueryRegistry::QueryRegistry(const std::string& filePath) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        std::cout << "No query registry at " << filePath << ", named queries disabled." << std::endl;
+        return;
+    }
+    try {
+        json config = json::parse(file);
+        whitelistOnly_ = config.value("whitelist_only", false);
+        if (config.contains("queries")) {
+            for (auto& entry : config["queries"].items()) {
+                const json& value = entry.value();
+                NamedQuery query;
+                query.name = entry.key();
+                if (value.is_object() && value.contains("cache")) {
+                    const json& cache = value["cache"];
+                    query.cached = true;
+                    query.cacheTable = cache.at("table").get<std::string>();
+                    query.cacheColumn = cache.value("column", "");
+                    query.cacheRange = cache.value("range", false);
+                } else {
+                    query.sql = value.is_string() ? value.get<std::string>() : value.at("sql").get<std::string>();
+                }
+                query.index = queries_.size();
+                query.kind = classifyStatement(query.sql);
+                if (value.is_object()) {
+                    query.bulkhead = value.value("class", "");
+                }
+                if (value.is_object() && value.contains("coalesce")) {
+                    const json& coalesce = value["coalesce"];
+                    query.coalesce = true;
+                    query.coalesceSelect = coalesce.at("select").get<std::string>();
+                    query.coalesceKey = coalesce.at("key").get<std::string>();
+                    query.coalesceWindowUs = coalesce.value("window_us", 200);
+                    query.coalesceMaxBatch = std::max<size_t>(1, coalesce.value("max_batch", 64));
+                }
+                byName_[query.name] = query.index;
+                queries_.push_back(query);
+            }
+        }
+        addCoalesceStatements();
+        if (config.contains("cached_tables")) {
+            for (auto& entry : config["cached_tables"].items()) {
+                const json& value = entry.value();
+                CachedTableConfig table;
+                table.table = entry.key();
+                table.key = value.at("key").get<std::string>();
+                table.indexes = value.value("indexes", std::vector<std::string>());
+                table.refreshSeconds = value.value("refresh_seconds", 60);
+                cachedTables_.push_back(table);
+            }
+        }
+        if (config.contains("class_rules")) {
+            for (const json& value : config["class_rules"]) {
+                BulkheadRule rule;
+                rule.pattern = value.at("fingerprint").get<std::string>();
+                rule.bulkhead = value.at("class").get<std::string>();
+                bulkheadRules_.push_back(rule);
+            }
+        }
+    } catch (const json::exception &e) {
+        std::cerr << "Invalid query registry " << filePath << ": " << e.what() << std::endl;
+        queries_.clear();
+        byName_.clear();
+        cachedTables_.clear();
+        bulkheadRules_.clear();
+        return;
+    }
+    std::cout << "Loaded " << byName_.size() << " named queries from " << filePath << std::endl;
+}
+
+// Appends the hidden IN statements for coalesced lookups. They are not added
+// to byName_, so clients can't call them directly.
+void QueryRegistry::addCoalesceStatements() {
+    size_t visible = queries_.size();
+    for (size_t i = 0; i < visible; ++i) {
+        if (!queries_[i].coalesce) {
+            continue;
+        }
+        std::vector<std::pair<size_t, size_t>> statements;
+        for (size_t count = 1; ; count *= 2) {
+            size_t placeholders = std::min(count, queries_[i].coalesceMaxBatch);
+            NamedQuery in;
+            in.name = queries_[i].name + "#in" + std::to_string(placeholders);
+            in.sql = queries_[i].coalesceSelect + " WHERE " + queries_[i].coalesceKey + " IN (?";
+            for (size_t p = 1; p < placeholders; ++p) {
+                in.sql += ", ?";
+            }
+            in.sql += ")";
+            in.index = queries_.size();
+            in.kind = StatementKind::Query;
+            statements.emplace_back(placeholders, in.index);
+            queries_.push_back(in);
+            if (placeholders == queries_[i].coalesceMaxBatch) {
+                break;
+            }
+        }
+        queries_[i].coalesceStatements = statements;
+    }
+}
+
+const NamedQuery* QueryRegistry::find(const std::string& name) const {
+    auto it = byName_.find(name);
+    return it == byName_.end() ? nullptr : &queries_[it->second];
+}
+
+std::vector<std::string> QueryRegistry::statements() const {
+    std::vector<std::string> sql;
+    for (const NamedQuery& query : queries_) {
+        sql.push_back(query.sql);
+    }
+    return sql;
+}
+
+namespace {
+
+class ParamText : public boost::static_visitor<std::string> {
+public:
+    std::string operator()(const boost::blank&) const { return ""; }
+    std::string operator()(bool value) const { return value ? "1" : "0"; }
+    std::string operator()(int64_t value) const { return std::to_string(value); }
+    std::string operator()(uint64_t value) const { return std::to_string(value); }
+    std::string operator()(double value) const { return std::to_string(value); }
+    std::string operator()(const std::string& value) const { return value; }
+};
+
+class ParamBinder : public boost::static_visitor<void> {
+public:
+    ParamBinder(sql::PreparedStatement& stmt, unsigned int index) : stmt_(stmt), index_(index) {}
+    void operator()(const boost::blank&) const { stmt_.setNull(index_, sql::DataType::SQLNULL); }
+    void operator()(bool value) const { stmt_.setBoolean(index_, value); }
+    void operator()(int64_t value) const { stmt_.setInt64(index_, value); }
+    void operator()(uint64_t value) const { stmt_.setUInt64(index_, value); }
+    void operator()(double value) const { stmt_.setDouble(index_, value); }
+    void operator()(const std::string& value) const { stmt_.setString(index_, value); }
+
+private:
+    sql::PreparedStatement& stmt_;
+    unsigned int index_;
+};
+
+}
+
+std::string paramText(const QueryParam& param) {
+    return boost::apply_visitor(ParamText(), param);
+}
+
+void bindParams(sql::PreparedStatement& stmt, const std::vector<QueryParam>& params) {
+    stmt.clearParameters();
+    for (size_t i = 0; i < params.size(); ++i) {
+        boost::apply_visitor(ParamBinder(stmt, static_cast<unsigned int>(i + 1)), params[i]);
+    }
+}
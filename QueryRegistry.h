@@ -0,0 +1,114 @@
+#ifndef QUERY_REGISTRY_H
+#define QUERY_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <boost/variant.hpp>
+#include <cppconn/prepared_statement.h>
+#include "SqlStatement.h"
+
+// A bound parameter for a named query. boost::blank binds SQL NULL.
+typedef boost::variant<boost::blank, bool, int64_t, uint64_t, double, std::string> QueryParam;
+
+// A parameterized statement clients can run by name instead of sending SQL.
+struct NamedQuery {
+    std::string name;
+    std::string sql;
+    size_t index;       // position in the registry, used to find the prepared statement
+    StatementKind kind;
+
+    // Single-key lookups that may be merged across requests into one
+    // "<select> WHERE <key> IN (...)" query (see LookupCoalescer).
+    bool coalesce = false;
+    std::string coalesceSelect;
+    std::string coalesceKey;
+    int coalesceWindowUs = 0;
+    size_t coalesceMaxBatch = 0;
+    // (placeholder count, registry index) of the IN statements, smallest first
+    std::vector<std::pair<size_t, size_t>> coalesceStatements;
+
+    // Answered from TableCache instead of MySQL; sql is empty. Looks up
+    // cacheColumn = ?, or primary key BETWEEN ? AND ? when cacheRange is set.
+    bool cached = false;
+    std::string cacheTable;
+    std::string cacheColumn;
+    bool cacheRange = false;
+
+    // Bulkhead ("class") the query always runs in; empty to classify it by
+    // observed latency (see BulkheadClassifier).
+    std::string bulkhead;
+};
+
+// Runs raw SQL whose fingerprint matches pattern (ECMAScript regex) in bulkhead
+struct BulkheadRule {
+    std::string pattern;
+    std::string bulkhead;
+};
+
+// A table mirrored in memory by TableCache
+struct CachedTableConfig {
+    std::string table;
+    std::string key;                  // primary key column
+    std::vector<std::string> indexes; // columns with a secondary hash index
+    int refreshSeconds;
+};
+
+// Named, parameterized statements loaded from a JSON file:
+//
+//   {
+//     "whitelist_only": false,
+//     "queries": {
+//       "person_by_id": "SELECT * FROM person WHERE id = ?",
+//       "person_insert": {"sql": "INSERT INTO person (name, email) VALUES (?, ?)"},
+//       "person_by_id_batched": {
+//         "sql": "SELECT * FROM person WHERE id = ?",
+//         "coalesce": {"select": "SELECT * FROM person", "key": "id", "window_us": 200, "max_batch": 64}
+//       },
+//       "person_by_email_cached": {"cache": {"table": "person", "column": "email"}},
+//       "person_id_range_cached": {"cache": {"table": "person", "range": true}},
+//       "person_report": {"sql": "SELECT ...", "class": "analytic"}
+//     },
+//     "class_rules": [
+//       {"fingerprint": "GROUP BY|COUNT\\(", "class": "analytic"}
+//     ],
+//     "cached_tables": {
+//       "person": {"key": "id", "indexes": ["email"], "refresh_seconds": 60}
+//     }
+//   }
+//
+// With whitelist_only set, clients may only run registered queries. A
+// "coalesce" entry registers hidden "WHERE key IN (?, ...)" statements with
+// 1, 2, 4, ... max_batch placeholders so they are prepared up front too.
+class QueryRegistry {
+public:
+    QueryRegistry(const std::string& filePath);
+
+    // nullptr when no query has that name
+    const NamedQuery* find(const std::string& name) const;
+    const std::vector<NamedQuery>& queries() const { return queries_; }
+    const std::vector<CachedTableConfig>& cachedTables() const { return cachedTables_; }
+    const std::vector<BulkheadRule>& bulkheadRules() const { return bulkheadRules_; }
+    // SQL text of every query, in index order, for preparing on connections
+    std::vector<std::string> statements() const;
+    bool whitelistOnly() const { return whitelistOnly_; }
+
+private:
+    void addCoalesceStatements();
+
+private:
+    std::vector<NamedQuery> queries_;
+    std::unordered_map<std::string, size_t> byName_;
+    std::vector<CachedTableConfig> cachedTables_;
+    std::vector<BulkheadRule> bulkheadRules_;
+    bool whitelistOnly_ = false;
+};
+
+// Text form of a parameter as MySQL returns it in a result set
+std::string paramText(const QueryParam& param);
+
+// Binds params to the statement's placeholders, in order.
+void bindParams(sql::PreparedStatement& stmt, const std::vector<QueryParam>& params);
+
+#endif
@@ -0,0 +1,143 @@
+#include "QueryWatchdog.h"
+#include <cppconn/statement.h>
+#include <cppconn/exception.h>
+#include "Logger.h"
+#include <memory>
+#include <vector>
+
+// How long a cancel that found nothing running waits for its query to begin()
+static const std::chrono::seconds pendingCancelLifetime(60);
+
+QueryWatchdog::QueryWatchdog(MySQLConnectionPool& pool, std::chrono::milliseconds checkInterval)
+    : pool_(pool), checkInterval_(checkInterval) {
+    watchThread_ = std::thread([this]() {
+        watchLoop();
+    });
+}
+
+QueryWatchdog::~QueryWatchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        watching_ = false;
+    }
+    wake_.notify_all();
+    if (watchThread_.joinable()) {
+        watchThread_.join();
+    }
+    delete killConnection_;
+}
+
+uint64_t QueryWatchdog::begin(const std::string& clientId, const std::string& queryId, uint64_t connectionId,
+                              std::chrono::steady_clock::time_point deadline) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t token = nextToken_++;
+    Running& query = running_[token];
+    query.clientId = clientId;
+    query.queryId = queryId;
+    query.connectionId = connectionId;
+    query.deadline = deadline;
+    auto pending = pendingCancels_.find(std::make_pair(clientId, queryId));
+    if (pending != pendingCancels_.end()) {
+        // Nothing has run on the connection yet, so there is nothing to KILL
+        pendingCancels_.erase(pending);
+        query.outcome = Outcome::Cancelled;
+        query.killed = true;
+    }
+    return token;
+}
+
+bool QueryWatchdog::cancelledBeforeStart(uint64_t token) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = running_.find(token);
+    return it != running_.end() && it->second.outcome == Outcome::Cancelled;
+}
+
+QueryWatchdog::Outcome QueryWatchdog::end(uint64_t token) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = running_.find(token);
+    if (it == running_.end()) {
+        return Outcome::None;
+    }
+    killDone_.wait(lock, [&] { return !it->second.killing; });
+    Outcome outcome = it->second.killed ? it->second.outcome : Outcome::None;
+    running_.erase(it);
+    return outcome;
+}
+
+bool QueryWatchdog::cancel(const std::string& clientId, const std::string& queryId) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool found = false;
+        for (auto& entry : running_) {
+            if (entry.second.clientId == clientId && entry.second.queryId == queryId) {
+                entry.second.outcome = Outcome::Cancelled;
+                found = true;
+            }
+        }
+        if (!found) {
+            pendingCancels_[std::make_pair(clientId, queryId)] = std::chrono::steady_clock::now();
+            return false;
+        }
+    }
+    wake_.notify_one();
+    return true;
+}
+
+uint64_t QueryWatchdog::kills() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return kills_;
+}
+
+void QueryWatchdog::watchLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (watching_) {
+        wake_.wait_for(lock, checkInterval_);
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = pendingCancels_.begin(); it != pendingCancels_.end();) {
+            it = now - it->second >= pendingCancelLifetime ? pendingCancels_.erase(it) : std::next(it);
+        }
+        std::vector<uint64_t> victims;
+        for (auto& entry : running_) {
+            Running& query = entry.second;
+            if (query.killed || query.connectionId == 0) {
+                continue;
+            }
+            if (query.outcome == Outcome::None && now >= query.deadline) {
+                query.outcome = Outcome::Timeout;
+            }
+            if (query.outcome != Outcome::None) {
+                query.killed = true;
+                query.killing = true;
+                victims.push_back(entry.first);
+            }
+        }
+
+        for (uint64_t token : victims) {
+            uint64_t connectionId = running_[token].connectionId;
+            lock.unlock();
+            kill(connectionId);
+            lock.lock();
+            running_[token].killing = false;
+            ++kills_;
+        }
+        if (!victims.empty()) {
+            killDone_.notify_all();
+        }
+    }
+}
+
+void QueryWatchdog::kill(uint64_t connectionId) {
+    try {
+        if (!killConnection_ || !killConnection_->isValid()) {
+            delete killConnection_;
+            killConnection_ = nullptr;
+            killConnection_ = pool_.openConnection();
+        }
+        std::unique_ptr<sql::Statement> stmt(killConnection_->createStatement());
+        stmt->execute("KILL QUERY " + std::to_string(connectionId));
+    } catch (sql::SQLException &e) {
+        // The query may already have finished (unknown thread id)
+        Logger::instance().log(LogLevel::Warn, "KILL QUERY failed", {{"connection_id", std::to_string(connectionId)}, {"error", e.what()}});
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef QUERY_WATCHDOG_H
+#define QUERY_WATCHDOG_H
+
+#include <string>
+#include <unordered_map>
+#include <map>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include "mySQLConnectionPool.h"
+
+// Tracks queries while they run on a pooled connection and kills them with
+// KILL QUERY, sent over a dedicated side connection, once their deadline has
+// passed or the client cancels them. Workers wrap each execution in
+// begin()/end(); end() reports why the query was killed, if it was, so the
+// worker can reply TIMEOUT or CANCELLED instead of the interrupted-query error.
+class QueryWatchdog {
+public:
+    enum class Outcome { None, Timeout, Cancelled };
+
+    QueryWatchdog(MySQLConnectionPool& pool, std::chrono::milliseconds checkInterval);
+    ~QueryWatchdog();
+
+    // deadline may be time_point::max() for queries that only need to be cancellable
+    uint64_t begin(const std::string& clientId, const std::string& queryId, uint64_t connectionId,
+                   std::chrono::steady_clock::time_point deadline);
+    // Must be called before the connection goes back to the pool. Waits for
+    // an in-progress KILL so it can't hit the connection's next query.
+    Outcome end(uint64_t token);
+    // True when the query was cancelled before it started; it should not be
+    // run, but end() must still be called
+    bool cancelledBeforeStart(uint64_t token);
+    // Kills a running query of this client; false if none is running. The
+    // cancel is then kept for a while in case the query is between leaving
+    // the request queue and begin(), and applies once it gets there.
+    bool cancel(const std::string& clientId, const std::string& queryId);
+    uint64_t kills();
+
+private:
+    struct Running {
+        std::string clientId;
+        std::string queryId;
+        uint64_t connectionId;
+        std::chrono::steady_clock::time_point deadline;
+        Outcome outcome = Outcome::None;
+        bool killed = false;  // KILL QUERY already sent
+        bool killing = false; // KILL QUERY in progress
+    };
+
+    void watchLoop();
+    void kill(uint64_t connectionId);
+
+private:
+    MySQLConnectionPool& pool_;
+    std::chrono::milliseconds checkInterval_;
+    std::unordered_map<uint64_t, Running> running_;
+    // (client, query) -> when a cancel found nothing running
+    std::map<std::pair<std::string, std::string>, std::chrono::steady_clock::time_point> pendingCancels_;
+    uint64_t nextToken_ = 1;
+    uint64_t kills_ = 0;
+    sql::Connection* killConnection_ = nullptr; // used by the watch thread only
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable killDone_;
+    std::thread watchThread_;
+    bool watching_ = true;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include "QueryRegistry.h"
+
+// A request received from a client
+struct Request {
+    std::string queryId;
+    std::string query;
+    std::string clientId;
+    std::string queryName; // set instead of query to run a registered named query
+    std::vector<QueryParam> params;
+    std::string ackMode; // "", "none", "queued" or "committed"
+    std::string command; // set instead of query for server commands, e.g. "stats"
+
+    // Scheduling: priority class (0 is most urgent) and optional deadline
+    int priority = 1;
+    std::chrono::steady_clock::time_point received;
+    std::chrono::steady_clock::time_point deadline; // zero when not set
+    std::chrono::steady_clock::time_point dequeued; // when a worker took it
+
+    bool trace = false; // reply with a per-stage "timing" map
+    bool multipart = false; // large replies may come as several frames to concatenate
+
+    // Span export (see SpanExporter): the client's trace and span ids, if
+    // any, the head sampling decision and when the message was read
+    std::string traceId;
+    std::string parentSpanId;
+    bool sampled = false;
+    std::chrono::steady_clock::time_point arrived;
+
+    // Set by BulkheadClassifier
+    int bulkhead = 0;
+    std::string fingerprint; // latency history and statistics key
+    uint64_t fingerprintHash = 0;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "RequestCapture.h"
+#include "nlohmann/json.hpp"
+#include <msgpack.hpp>
+#include <iostream>
+
+namespace {
+
+    std::string hex(const std::string& bytes) {
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        out.reserve(bytes.size() * 2);
+        for (unsigned char c : bytes) {
+            out += digits[c >> 4];
+            out += digits[c & 0xf];
+        }
+        return out;
+    }
+
+    nlohmann::json toJson(const msgpack::object& object) {
+        switch (object.type) {
+            case msgpack::type::NIL:
+                return nullptr;
+            case msgpack::type::BOOLEAN:
+                return object.via.boolean;
+            case msgpack::type::POSITIVE_INTEGER:
+                return object.via.u64;
+            case msgpack::type::NEGATIVE_INTEGER:
+                return object.via.i64;
+            case msgpack::type::FLOAT32:
+            case msgpack::type::FLOAT64:
+                return object.via.f64;
+            case msgpack::type::STR:
+                return std::string(object.via.str.ptr, object.via.str.size);
+            case msgpack::type::BIN:
+                return std::string(object.via.bin.ptr, object.via.bin.size);
+            case msgpack::type::ARRAY: {
+                nlohmann::json array = nlohmann::json::array();
+                for (uint32_t i = 0; i < object.via.array.size; ++i) {
+                    array.push_back(toJson(object.via.array.ptr[i]));
+                }
+                return array;
+            }
+            case msgpack::type::MAP: {
+                nlohmann::json map = nlohmann::json::object();
+                for (uint32_t i = 0; i < object.via.map.size; ++i) {
+                    const msgpack::object_kv& entry = object.via.map.ptr[i];
+                    std::string key = entry.key.type == msgpack::type::STR ? entry.key.as<std::string>() : toJson(entry.key).dump();
+                    map[key] = toJson(entry.val);
+                }
+                return map;
+            }
+            default:
+                return nullptr;
+        }
+    }
+}
+
+RequestCapture::RequestCapture(const std::string& path, uint64_t maxFileBytes)
+    : path_(path), maxFileBytes_(maxFileBytes) {
+    if (path_.empty()) {
+        return;
+    }
+    file_.open(path_, std::ios::out | std::ios::app);
+    if (!file_.is_open()) {
+        std::cerr << "Request capture disabled, cannot open " << path_ << std::endl;
+        return;
+    }
+    file_.seekp(0, std::ios::end);
+    fileBytes_ = static_cast<uint64_t>(file_.tellp());
+    enabled_ = fileBytes_ < maxFileBytes_;
+    writer_ = std::thread(&RequestCapture::run, this);
+    std::cout << "Capturing requests to " << path_ << std::endl;
+}
+
+RequestCapture::~RequestCapture() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void RequestCapture::record(const std::string& clientId, const std::string& payload) {
+    if (!enabled_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= maxQueued) {
+            ++dropped_;
+            return;
+        }
+        queue_.push_back(Message{std::chrono::system_clock::now(), clientId, payload});
+    }
+    condition_.notify_one();
+}
+
+void RequestCapture::run() {
+    std::vector<Message> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return; // stopping
+            }
+            batch.swap(queue_);
+        }
+        for (const Message& message : batch) {
+            if (enabled_) {
+                write(message);
+            }
+        }
+        file_.flush();
+        batch.clear();
+    }
+}
+
+void RequestCapture::write(const Message& message) {
+    nlohmann::json request;
+    try {
+        msgpack::object_handle handle = msgpack::unpack(message.payload.data(), message.payload.size());
+        request = toJson(handle.get());
+    } catch (const std::exception&) {
+        return; // the receive loop reports malformed messages
+    }
+    if (!request.is_object()) {
+        return;
+    }
+    nlohmann::json line = {
+        {"ts_us", std::chrono::duration_cast<std::chrono::microseconds>(message.received.time_since_epoch()).count()},
+        {"client", hex(message.clientId)},
+        {"request", request}
+    };
+    std::string text = line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    text += '\n';
+    file_ << text;
+    fileBytes_ += text.size();
+    ++captured_;
+    if (fileBytes_ >= maxFileBytes_) {
+        std::cerr << "Request capture stopped, " << path_ << " reached its size limit" << std::endl;
+        enabled_ = false;
+    }
+}
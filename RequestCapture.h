@@ -0,0 +1,65 @@
+#ifndef REQUEST_CAPTURE_H
+#define REQUEST_CAPTURE_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstdint>
+
+// Records incoming client messages to a JSON-lines file for replay with
+// bench/replay, one message per line:
+//
+//   {"ts_us":1760000000123456,"client":"006b8b4567","request":{"id":"q1","query":"SELECT ..."}}
+//
+// ts_us is the wall-clock receive time in microseconds, client the hex
+// socket identity and request the decoded MessagePack message. The receive
+// loop only copies the raw payload into a queue; decoding and writing
+// happen on a background thread. Messages are dropped when the queue is
+// full, and capture stops once the file reaches maxFileBytes.
+class RequestCapture {
+public:
+    // An empty path disables capture
+    RequestCapture(const std::string& path, uint64_t maxFileBytes);
+    ~RequestCapture();
+
+    bool enabled() const { return enabled_; }
+    void record(const std::string& clientId, const std::string& payload);
+
+    uint64_t captured() const { return captured_; }
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    struct Message {
+        std::chrono::system_clock::time_point received;
+        std::string clientId;
+        std::string payload;
+    };
+
+    void run();
+    void write(const Message& message);
+
+private:
+    static const size_t maxQueued = 100000;
+
+    std::string path_;
+    uint64_t maxFileBytes_;
+    std::atomic<bool> enabled_{false};
+
+    std::vector<Message> queue_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_ = false;
+    std::atomic<uint64_t> captured_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::ofstream file_;
+    uint64_t fileBytes_ = 0;
+    std::thread writer_;
+};
+
+#endif
@@ -0,0 +1,257 @@
+#include "RequestScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+RequestScheduler::RequestScheduler(int classes, std::chrono::milliseconds agingThreshold, int quantum, size_t maxOutstandingPerClient,
+                                   size_t capacity, std::chrono::milliseconds codelTarget, std::chrono::milliseconds codelInterval)
+    : queues_(std::max(1, classes)), agingThreshold_(agingThreshold), quantum_(std::max(1, quantum)),
+      maxOutstandingPerClient_(maxOutstandingPerClient), capacity_(capacity), codelTarget_(codelTarget),
+      codelInterval_(codelInterval) {
+}
+
+RequestScheduler::PushResult RequestScheduler::push(Request request) {
+    request.priority = std::min(std::max(request.priority, 0), classes() - 1);
+    std::chrono::steady_clock::time_point deadline = request.deadline;
+    if (deadline == std::chrono::steady_clock::time_point()) {
+        deadline = request.received + agingThreshold_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size_ >= capacity_) {
+            ++rejected_;
+            return PushResult::QueueFull;
+        }
+        size_t& outstanding = outstanding_[request.clientId];
+        if (outstanding >= maxOutstandingPerClient_) {
+            ++rejected_;
+            return PushResult::ClientBusy;
+        }
+        ++outstanding;
+
+        ClassState& queue = queues_[request.priority];
+        auto inserted = queue.clients.emplace(request.clientId, ClientQueue());
+        if (inserted.second) {
+            queue.active.push_back(request.clientId);
+        }
+        std::vector<Entry>& heap = inserted.first->second.heap;
+        heap.push_back(Entry{deadline, sequence_++, std::move(request)});
+        std::push_heap(heap.begin(), heap.end(), Later());
+        ++queue.depth;
+        ++size_;
+    }
+    available_.notify_one();
+    return PushResult::Accepted;
+}
+
+int RequestScheduler::selectClass(std::chrono::steady_clock::time_point now) {
+    int best = -1;
+    for (int c = 0; c < classes(); ++c) {
+        ClassState& queue = queues_[c];
+        if (queue.depth == 0) {
+            continue;
+        }
+        if (best < 0) {
+            best = c;
+            continue;
+        }
+        const Entry& next = queue.clients[queue.active.front()].heap.front();
+        if (now - next.request.received >= agingThreshold_ * (c - best)) {
+            ++queue.aged;
+            return c;
+        }
+    }
+    return best;
+}
+
+// Deficit round robin over the class's clients, one request per call
+Request RequestScheduler::takeNext(ClassState& queue) {
+    std::string clientId = queue.active.front();
+    ClientQueue& client = queue.clients[clientId];
+    if (client.deficit <= 0) {
+        client.deficit += quantum_;
+    }
+
+    std::pop_heap(client.heap.begin(), client.heap.end(), Later());
+    Request request = std::move(client.heap.back().request);
+    client.heap.pop_back();
+    --client.deficit;
+    --queue.depth;
+
+    queue.active.pop_front();
+    if (client.heap.empty()) {
+        queue.clients.erase(clientId);
+    } else if (client.deficit > 0) {
+        queue.active.push_front(clientId); // turn continues
+    } else {
+        queue.active.push_back(clientId);
+    }
+    return request;
+}
+
+std::chrono::steady_clock::time_point RequestScheduler::controlLaw(std::chrono::steady_clock::time_point t, uint32_t count) const {
+    return t + std::chrono::duration_cast<std::chrono::steady_clock::duration>(codelInterval_ / std::sqrt(static_cast<double>(count)));
+}
+
+// CoDel (RFC 8289) drop decision for a request that waited sojourn
+bool RequestScheduler::shouldShed(ClassState& queue, std::chrono::steady_clock::duration sojourn, std::chrono::steady_clock::time_point now) {
+    CoDelState& codel = queue.codel;
+    bool okToDrop = false;
+    if (sojourn < codelTarget_ || queue.depth == 0) {
+        codel.firstAboveTime = std::chrono::steady_clock::time_point();
+    } else if (codel.firstAboveTime == std::chrono::steady_clock::time_point()) {
+        codel.firstAboveTime = now + codelInterval_;
+    } else {
+        okToDrop = now >= codel.firstAboveTime;
+    }
+
+    if (codel.dropping) {
+        if (!okToDrop) {
+            codel.dropping = false;
+            return false;
+        }
+        if (now >= codel.dropNext) {
+            ++codel.count;
+            codel.dropNext = controlLaw(codel.dropNext, codel.count);
+            return true;
+        }
+        return false;
+    }
+    if (okToDrop) {
+        // Resume near the previous drop rate if we were dropping recently
+        codel.dropping = true;
+        uint32_t delta = codel.count - codel.lastCount;
+        codel.count = (delta > 1 && now - codel.dropNext < codelInterval_ * 16) ? delta : 1;
+        codel.lastCount = codel.count;
+        codel.dropNext = controlLaw(now, codel.count);
+        return true;
+    }
+    return false;
+}
+
+bool RequestScheduler::pop(Request& request, std::vector<Request>& shed) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t interrupts = interrupts_;
+    available_.wait(lock, [&] { return size_ > 0 || interrupts_ != interrupts; });
+
+    while (size_ > 0) {
+        auto now = std::chrono::steady_clock::now();
+        ClassState& queue = queues_[selectClass(now)];
+        Request next = takeNext(queue);
+        --size_;
+
+        auto sojourn = now - next.received;
+        double waitMs = std::chrono::duration<double, std::milli>(sojourn).count();
+        waitEwmaMs_ += (waitMs - waitEwmaMs_) / 16;
+        if (shouldShed(queue, sojourn, now)) {
+            ++queue.shed;
+            shed.push_back(std::move(next));
+            continue;
+        }
+
+        ++queue.dequeued;
+        queue.totalWaitMs += waitMs;
+        queue.maxWaitMs = std::max(queue.maxWaitMs, waitMs);
+        request = std::move(next);
+        return true;
+    }
+    return false;
+}
+
+void RequestScheduler::interrupt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++interrupts_;
+    }
+    available_.notify_all();
+}
+
+int RequestScheduler::retryAfterMs() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::max(1, static_cast<int>(waitEwmaMs_));
+}
+
+uint64_t RequestScheduler::rejected() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rejected_;
+}
+
+void RequestScheduler::release(const std::string& clientId) {
+    auto it = outstanding_.find(clientId);
+    if (it != outstanding_.end() && --it->second == 0) {
+        outstanding_.erase(it);
+    }
+}
+
+void RequestScheduler::complete(const std::string& clientId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    release(clientId);
+}
+
+bool RequestScheduler::cancel(const std::string& clientId, const std::string& queryId, Request& removed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (ClassState& queue : queues_) {
+        auto client = queue.clients.find(clientId);
+        if (client == queue.clients.end()) {
+            continue;
+        }
+        std::vector<Entry>& heap = client->second.heap;
+        for (auto it = heap.begin(); it != heap.end(); ++it) {
+            if (it->request.queryId == queryId) {
+                removed = std::move(it->request);
+                heap.erase(it);
+                std::make_heap(heap.begin(), heap.end(), Later());
+                if (heap.empty()) {
+                    queue.clients.erase(client);
+                    queue.active.erase(std::find(queue.active.begin(), queue.active.end(), clientId));
+                }
+                --queue.depth;
+                --size_;
+                release(clientId);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t RequestScheduler::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+std::vector<RequestScheduler::ClassStats> RequestScheduler::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ClassStats> result;
+    for (const ClassState& queue : queues_) {
+        ClassStats s;
+        s.depth = queue.depth;
+        s.clients = queue.clients.size();
+        s.dequeued = queue.dequeued;
+        s.aged = queue.aged;
+        s.shed = queue.shed;
+        s.avgWaitMs = queue.dequeued ? queue.totalWaitMs / queue.dequeued : 0;
+        s.maxWaitMs = queue.maxWaitMs;
+        result.push_back(s);
+    }
+    return result;
+}
+
+size_t RequestScheduler::capacity() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+}
+
+void RequestScheduler::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+}
+
+size_t RequestScheduler::maxOutstandingPerClient() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return maxOutstandingPerClient_;
+}
+
+void RequestScheduler::setMaxOutstandingPerClient(size_t maxOutstanding) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxOutstandingPerClient_ = maxOutstanding;
+}
@@ -0,0 +1,138 @@
+#ifndef REQUEST_SCHEDULER_H
+#define REQUEST_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "Request.h"
+
+// Multi-level request queue shared by the worker threads.
+//
+// Classes are served in strict priority order (class 0 first). Within a
+// class, clients (DEALER identities) share the workers by deficit round
+// robin: each client in turn may take up to quantum requests, so a client
+// pipelining thousands of queries can't push everyone else's requests
+// behind its own. A client's own requests are served earliest-deadline-
+// first; a request without a deadline gets an implicit one of received +
+// agingThreshold, so it is ordered among explicit deadlines instead of
+// waiting behind all of them.
+// Aging: the next request of a lower class that has waited agingThreshold
+// for every class it is below is served ahead of the higher classes, so
+// low-priority work keeps making progress under sustained high-priority load.
+//
+// Overload: the queue holds at most capacity requests, and each class runs
+// CoDel on queue sojourn time. Once requests of a class have waited longer
+// than codelTarget for a whole codelInterval, dequeued requests are shed at
+// an increasing rate until the wait drops below target again. Shed requests
+// are handed back to the worker to answer BUSY instead of being run late.
+class RequestScheduler {
+public:
+    struct ClassStats {
+        size_t depth;
+        size_t clients;  // clients with queued requests
+        uint64_t dequeued;
+        uint64_t aged;   // served ahead of a higher class by aging
+        uint64_t shed;   // dropped by CoDel
+        double avgWaitMs;
+        double maxWaitMs;
+    };
+
+    enum class PushResult { Accepted, ClientBusy, QueueFull };
+
+    // maxOutstandingPerClient caps queued plus running requests of one client
+    RequestScheduler(int classes, std::chrono::milliseconds agingThreshold, int quantum, size_t maxOutstandingPerClient,
+                     size_t capacity, std::chrono::milliseconds codelTarget, std::chrono::milliseconds codelInterval);
+
+    // Clamps the request's priority to the configured classes. Nothing is
+    // queued unless the result is Accepted.
+    PushResult push(Request request);
+    // Blocks until there is work. Returns false when the only work is
+    // requests shed by CoDel, which are appended to shed; every shed request
+    // must still be complete()d.
+    bool pop(Request& request, std::vector<Request>& shed);
+    // Makes every pop() blocked on an empty queue return false, so workers
+    // can check whether they should exit
+    void interrupt();
+    // Suggested client back-off for BUSY replies: the recent queue wait
+    int retryAfterMs();
+    uint64_t rejected();
+    // Called once a popped request has been handled
+    void complete(const std::string& clientId);
+    // Removes a queued request of this client; false if it isn't queued
+    bool cancel(const std::string& clientId, const std::string& queryId, Request& removed);
+    size_t size();
+    int classes() const { return static_cast<int>(queues_.size()); }
+    std::vector<ClassStats> stats();
+
+    // Limits can be changed while requests are queued; requests already
+    // queued are kept even if they exceed a lowered limit.
+    size_t capacity();
+    void setCapacity(size_t capacity);
+    size_t maxOutstandingPerClient();
+    void setMaxOutstandingPerClient(size_t maxOutstanding);
+
+private:
+    struct Entry {
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t sequence; // FIFO among equal deadlines
+        Request request;
+    };
+    // Heap order: earliest deadline on top
+    struct Later {
+        bool operator()(const Entry& a, const Entry& b) const {
+            return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+        }
+    };
+    struct ClientQueue {
+        std::vector<Entry> heap;
+        int deficit = 0;
+    };
+    struct CoDelState {
+        std::chrono::steady_clock::time_point firstAboveTime;
+        std::chrono::steady_clock::time_point dropNext;
+        uint32_t count = 0;
+        uint32_t lastCount = 0;
+        bool dropping = false;
+    };
+    struct ClassState {
+        std::unordered_map<std::string, ClientQueue> clients;
+        std::deque<std::string> active; // round-robin order of clients in clients
+        size_t depth = 0;
+        uint64_t dequeued = 0;
+        uint64_t aged = 0;
+        uint64_t shed = 0;
+        CoDelState codel;
+        double totalWaitMs = 0;
+        double maxWaitMs = 0;
+    };
+
+    int selectClass(std::chrono::steady_clock::time_point now);
+    Request takeNext(ClassState& queue);
+    void release(const std::string& clientId);
+    bool shouldShed(ClassState& queue, std::chrono::steady_clock::duration sojourn, std::chrono::steady_clock::time_point now);
+    std::chrono::steady_clock::time_point controlLaw(std::chrono::steady_clock::time_point t, uint32_t count) const;
+
+private:
+    std::vector<ClassState> queues_;
+    std::chrono::milliseconds agingThreshold_;
+    int quantum_;
+    size_t maxOutstandingPerClient_;
+    size_t capacity_;
+    std::chrono::steady_clock::duration codelTarget_;
+    std::chrono::steady_clock::duration codelInterval_;
+    double waitEwmaMs_ = 0;
+    uint64_t rejected_ = 0;
+    std::unordered_map<std::string, size_t> outstanding_;
+    uint64_t sequence_ = 0;
+    size_t size_ = 0;
+    uint64_t interrupts_ = 0;
+    std::mutex mutex_;
+    std::condition_variable available_;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "SpanExporter.h"
+#include "SqlStatement.h"
+#include "nlohmann/json.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+namespace {
+
+    std::string randomHex(int digits) {
+        thread_local std::mt19937_64 generator(std::random_device{}());
+        static const char hex[] = "0123456789abcdef";
+        std::string id;
+        id.reserve(digits);
+        while (static_cast<int>(id.size()) < digits) {
+            uint64_t bits = generator();
+            for (int i = 0; i < 16 && static_cast<int>(id.size()) < digits; ++i, bits >>= 4) {
+                id += hex[bits & 0xf];
+            }
+        }
+        return id;
+    }
+}
+
+SpanExporter::SpanExporter(const std::string& path, uint64_t maxFileBytes, int keepFiles, int samplePercent, int slowMs)
+    : path_(path), maxFileBytes_(maxFileBytes), keepFiles_(keepFiles), samplePercent_(samplePercent),
+      slow_(std::chrono::milliseconds(slowMs)) {
+    wallOffset_ = std::chrono::system_clock::now().time_since_epoch() -
+                  std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::steady_clock::now().time_since_epoch());
+    if (!enabled()) {
+        return;
+    }
+    file_.open(path_, std::ios::out | std::ios::app);
+    if (!file_.is_open()) {
+        std::cerr << "Span export disabled, cannot open " << path_ << std::endl;
+        path_.clear();
+        return;
+    }
+    file_.seekp(0, std::ios::end);
+    fileBytes_ = static_cast<uint64_t>(file_.tellp());
+    writer_ = std::thread(&SpanExporter::run, this);
+    std::cout << "Exporting spans to " << path_ << " (" << samplePercent_ << "% sampled)" << std::endl;
+}
+
+SpanExporter::~SpanExporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+std::string SpanExporter::newTraceId() {
+    return randomHex(32);
+}
+
+std::string SpanExporter::newSpanId() {
+    return randomHex(16);
+}
+
+bool SpanExporter::sampleTrace(const std::string& traceId) const {
+    if (samplePercent_ >= 100) {
+        return true;
+    }
+    if (samplePercent_ <= 0) {
+        return false;
+    }
+    if (traceId.empty()) {
+        thread_local std::mt19937_64 generator(std::random_device{}());
+        return generator() % 100 < static_cast<uint64_t>(samplePercent_);
+    }
+    // W3C trace ids end in random hex digits; anything else is hashed
+    uint64_t bits = 0;
+    if (traceId.size() >= 16) {
+        char* end = nullptr;
+        std::string tail = traceId.substr(traceId.size() - 16);
+        bits = std::strtoull(tail.c_str(), &end, 16);
+        if (*end != '\0') {
+            bits = fingerprintHash(traceId);
+        }
+    } else {
+        bits = fingerprintHash(traceId);
+    }
+    return bits % 100 < static_cast<uint64_t>(samplePercent_);
+}
+
+void SpanExporter::submit(TraceRecord&& trace) {
+    if (!enabled() || trace.spans.empty()) {
+        return;
+    }
+    const SpanRecord& root = trace.spans.front();
+    if (!trace.sampled && trace.error.empty() && root.end - root.start < slow_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= maxQueued) {
+            ++dropped_;
+            return;
+        }
+        queue_.push_back(std::move(trace));
+    }
+    condition_.notify_one();
+}
+
+void SpanExporter::run() {
+    std::vector<TraceRecord> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return; // stopping
+            }
+            batch.swap(queue_);
+        }
+        for (const TraceRecord& trace : batch) {
+            write(trace);
+        }
+        file_.flush();
+        exported_ += batch.size();
+        batch.clear();
+    }
+}
+
+void SpanExporter::write(const TraceRecord& trace) {
+    auto unixNanos = [this](std::chrono::steady_clock::time_point time) {
+        auto wall = std::chrono::duration_cast<std::chrono::system_clock::duration>(time.time_since_epoch()) + wallOffset_;
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count());
+    };
+    for (size_t i = 0; i < trace.spans.size(); ++i) {
+        const SpanRecord& span = trace.spans[i];
+        nlohmann::json line = {
+            {"trace_id", trace.traceId},
+            {"span_id", span.spanId},
+            {"name", span.name},
+            {"start_unix_nano", unixNanos(span.start)},
+            {"end_unix_nano", unixNanos(span.end)}
+        };
+        if (!span.parentSpanId.empty()) {
+            line["parent_span_id"] = span.parentSpanId;
+        }
+        if (i == 0) {
+            line["status"] = trace.error.empty() ? "ok" : "error";
+            nlohmann::json attributes = nlohmann::json::object();
+            for (const auto& attribute : trace.attributes) {
+                attributes[attribute.first] = attribute.second;
+            }
+            if (!trace.error.empty()) {
+                attributes["error"] = trace.error;
+            }
+            attributes["sampled"] = trace.sampled;
+            line["attributes"] = attributes;
+        }
+        std::string text = line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+        text += '\n';
+        file_ << text;
+        fileBytes_ += text.size();
+    }
+    if (fileBytes_ >= maxFileBytes_) {
+        rotate();
+    }
+}
+
+void SpanExporter::rotate() {
+    file_.close();
+    if (keepFiles_ == 0) {
+        std::remove(path_.c_str());
+    }
+    for (int i = keepFiles_; i >= 1; --i) {
+        std::string from = i == 1 ? path_ : path_ + "." + std::to_string(i - 1);
+        std::rename(from.c_str(), (path_ + "." + std::to_string(i)).c_str());
+    }
+    file_.open(path_, std::ios::out | std::ios::trunc);
+    fileBytes_ = 0;
+}
@@ -0,0 +1,95 @@
+#ifndef SPAN_EXPORTER_H
+#define SPAN_EXPORTER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstdint>
+
+// One timed stage of a request
+struct SpanRecord {
+    std::string name;
+    std::string spanId;
+    std::string parentSpanId;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+// The spans of one request. spans[0] is the root, a child of parentSpanId
+// when the client passed one; the other spans are its children.
+struct TraceRecord {
+    std::string traceId;
+    std::string parentSpanId;
+    bool sampled = false; // head sampling decision
+    std::string error;    // empty when the request succeeded
+    std::vector<std::pair<std::string, std::string>> attributes; // set on the root span
+    std::vector<SpanRecord> spans;
+};
+
+// Writes OpenTelemetry-style spans as JSON lines to a local file, one span
+// per line:
+//
+//   {"trace_id":"4bf92f3577b34da6a3ce929d0e0e4736","span_id":"00f067aa0ba902b7",
+//    "parent_span_id":"...","name":"execute","start_unix_nano":...,
+//    "end_unix_nano":...,"status":"ok","attributes":{...}}
+//
+// Sampling is decided per trace at the head, from the trace id so every
+// service sharing the id decides alike, and a tail rule keeps unsampled
+// traces that failed or took longer than slowMs. Traces are queued and
+// written by a background thread; when the queue is full they are dropped.
+// The file is rotated to path.1 ... path.<keepFiles> once it reaches
+// maxFileBytes.
+class SpanExporter {
+public:
+    // An empty path disables the exporter
+    SpanExporter(const std::string& path, uint64_t maxFileBytes, int keepFiles, int samplePercent, int slowMs);
+    ~SpanExporter();
+
+    bool enabled() const { return !path_.empty(); }
+    // Head sampling decision for a trace id; random for an empty one
+    bool sampleTrace(const std::string& traceId) const;
+    // Queues the trace if it was sampled, failed or was slow
+    void submit(TraceRecord&& trace);
+
+    uint64_t exported() const { return exported_; }
+    uint64_t dropped() const { return dropped_; }
+
+    // 32 and 16 random hex digits, as in W3C trace context
+    static std::string newTraceId();
+    static std::string newSpanId();
+
+private:
+    void run();
+    void write(const TraceRecord& trace);
+    void rotate();
+
+private:
+    static const size_t maxQueued = 10000;
+
+    std::string path_;
+    uint64_t maxFileBytes_;
+    int keepFiles_;
+    int samplePercent_;
+    std::chrono::steady_clock::duration slow_;
+    // steady_clock spans are reported in wall-clock time using this offset
+    std::chrono::system_clock::duration wallOffset_;
+
+    std::vector<TraceRecord> queue_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_ = false;
+    std::atomic<uint64_t> exported_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::ofstream file_;
+    uint64_t fileBytes_ = 0;
+    std::thread writer_;
+};
+
+#endif
@@ -0,0 +1,347 @@
+#include "SqlStatement.h"
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+bool isIdentifierChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || c == '.' || c == '`';
+}
+
+// Advances past whitespace and SQL comments starting at pos.
+size_t skipSpace(const std::string& sql, size_t pos) {
+    while (pos < sql.size()) {
+        char c = sql[pos];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            ++pos;
+        } else if (c == '#' || (c == '-' && pos + 1 < sql.size() && sql[pos + 1] == '-')) {
+            size_t end = sql.find('\n', pos);
+            pos = (end == std::string::npos) ? sql.size() : end + 1;
+        } else if (c == '/' && pos + 1 < sql.size() && sql[pos + 1] == '*') {
+            size_t end = sql.find("*/", pos + 2);
+            pos = (end == std::string::npos) ? sql.size() : end + 2;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+// Advances past a quoted string/identifier starting at pos (the opening quote).
+size_t skipQuoted(const std::string& sql, size_t pos) {
+    char quote = sql[pos++];
+    while (pos < sql.size()) {
+        char c = sql[pos++];
+        if (c == '\\' && quote != '`') {
+            ++pos;
+        } else if (c == quote) {
+            if (pos < sql.size() && sql[pos] == quote) {
+                ++pos; // doubled quote
+            } else {
+                break;
+            }
+        }
+    }
+    return pos;
+}
+
+// Reads the word at pos, upper-cased, and moves pos past it.
+std::string readWord(const std::string& sql, size_t& pos) {
+    pos = skipSpace(sql, pos);
+    std::string word;
+    while (pos < sql.size() && isIdentifierChar(sql[pos])) {
+        word += static_cast<char>(std::toupper(static_cast<unsigned char>(sql[pos])));
+        ++pos;
+    }
+    return word;
+}
+
+// Reads the identifier at pos preserving its case, without backticks.
+std::string readIdentifier(const std::string& sql, size_t& pos) {
+    pos = skipSpace(sql, pos);
+    std::string name;
+    while (pos < sql.size() && isIdentifierChar(sql[pos])) {
+        if (sql[pos] != '`') {
+            name += sql[pos];
+        }
+        ++pos;
+    }
+    return name;
+}
+
+bool endsWith(const std::string& s, const char* suffix) {
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// Appends a ? to a fingerprint. Inside an IN list or a VALUES row (inList),
+// lists of any length share one fingerprint, so "?, ?" runs collapse to "?"
+// as they are emitted, as do "(?), (?)" runs when their ")" is (see
+// statementFingerprint). Elsewhere, e.g. SELECT 1, 2 or LIMIT 10, 20, every
+// placeholder is kept.
+void appendPlaceholder(std::string& out, bool inList) {
+    if (inList && endsWith(out, "?, ")) {
+        out.resize(out.size() - 2);
+    } else {
+        out += '?';
+    }
+}
+
+}
+
+std::string leadingKeyword(const std::string& sql) {
+    size_t pos = skipSpace(sql, 0);
+    while (pos < sql.size() && sql[pos] == '(') {
+        pos = skipSpace(sql, pos + 1);
+    }
+    return readWord(sql, pos);
+}
+
+StatementKind classifyStatement(const std::string& sql) {
+    std::string keyword = leadingKeyword(sql);
+    if (keyword == "SELECT" || keyword == "SHOW" || keyword == "DESCRIBE" || keyword == "DESC" ||
+        keyword == "EXPLAIN" || keyword == "WITH" || keyword == "TABLE" || keyword == "VALUES") {
+        return StatementKind::Query;
+    }
+    if (keyword == "INSERT" || keyword == "REPLACE" || keyword == "UPDATE" || keyword == "DELETE" ||
+        keyword == "LOAD") {
+        return StatementKind::Update;
+    }
+    return StatementKind::Other;
+}
+
+std::string withMaxExecutionTime(const std::string& sql, long long ms) {
+    size_t pos = skipSpace(sql, 0);
+    std::string keyword = readWord(sql, pos);
+    if (keyword != "SELECT") {
+        return sql;
+    }
+    return sql.substr(0, pos) + " /*+ MAX_EXECUTION_TIME(" + std::to_string(ms < 1 ? 1 : ms) + ") */" + sql.substr(pos);
+}
+
+bool isWriteStatement(const std::string& sql) {
+    std::string keyword = leadingKeyword(sql);
+    return keyword == "INSERT" || keyword == "REPLACE" || keyword == "UPDATE" || keyword == "DELETE";
+}
+
+std::string statementTable(const std::string& sql) {
+    size_t pos = 0;
+    std::string keyword = readWord(sql, pos);
+    if (keyword == "INSERT" || keyword == "REPLACE" || keyword == "DELETE") {
+        // INSERT [LOW_PRIORITY | DELAYED | HIGH_PRIORITY] [IGNORE] [INTO] tbl
+        // DELETE [LOW_PRIORITY] [QUICK] [IGNORE] FROM tbl
+        size_t probe = pos;
+        std::string word = readWord(sql, probe);
+        while (word == "LOW_PRIORITY" || word == "DELAYED" || word == "HIGH_PRIORITY" ||
+               word == "QUICK" || word == "IGNORE" || word == "INTO" || word == "FROM") {
+            pos = probe;
+            word = readWord(sql, probe);
+        }
+        return readIdentifier(sql, pos);
+    }
+    if (keyword == "UPDATE") {
+        size_t probe = pos;
+        std::string word = readWord(sql, probe);
+        while (word == "LOW_PRIORITY" || word == "IGNORE") {
+            pos = probe;
+            word = readWord(sql, probe);
+        }
+        return readIdentifier(sql, pos);
+    }
+    return "";
+}
+
+bool splitInsertValues(const std::string& sql, std::string& prefix, std::string& rows, size_t& rowCount) {
+    std::string keyword = leadingKeyword(sql);
+    if (keyword != "INSERT" && keyword != "REPLACE") {
+        return false;
+    }
+
+    // Locate the VALUES keyword outside of quotes and parentheses
+    size_t pos = 0;
+    size_t valuesEnd = std::string::npos;
+    int depth = 0;
+    while (pos < sql.size()) {
+        char c = sql[pos];
+        if (c == '\'' || c == '"' || c == '`') {
+            pos = skipQuoted(sql, pos);
+        } else if (c == '(') {
+            ++depth;
+            ++pos;
+        } else if (c == ')') {
+            --depth;
+            ++pos;
+        } else if (depth == 0 && isIdentifierChar(c)) {
+            size_t start = pos;
+            std::string word = readWord(sql, pos);
+            if (word == "VALUES" || word == "VALUE") {
+                valuesEnd = pos;
+                break;
+            }
+            if (word == "SELECT" || word == "SET") {
+                return false;
+            }
+            if (pos == start) {
+                ++pos;
+            }
+        } else {
+            ++pos;
+        }
+    }
+    if (valuesEnd == std::string::npos) {
+        return false;
+    }
+
+    // Walk the row tuples; anything other than "(...)" separated by commas
+    // means the statement has a tail we can't merge.
+    pos = skipSpace(sql, valuesEnd);
+    size_t rowsStart = pos;
+    size_t rowsEnd = pos;
+    rowCount = 0;
+    while (pos < sql.size()) {
+        if (sql[pos] != '(') {
+            return false;
+        }
+        depth = 0;
+        do {
+            char c = sql[pos];
+            if (c == '\'' || c == '"' || c == '`') {
+                pos = skipQuoted(sql, pos);
+                continue;
+            }
+            if (c == '(') {
+                ++depth;
+            } else if (c == ')') {
+                --depth;
+            }
+            ++pos;
+        } while (pos < sql.size() && depth > 0);
+        if (depth != 0) {
+            return false;
+        }
+        ++rowCount;
+        rowsEnd = pos;
+        pos = skipSpace(sql, pos);
+        if (pos < sql.size() && sql[pos] == ',') {
+            pos = skipSpace(sql, pos + 1);
+            continue;
+        }
+        if (pos < sql.size() && sql[pos] == ';') {
+            pos = skipSpace(sql, pos + 1);
+        }
+        if (pos != sql.size()) {
+            return false;
+        }
+    }
+    if (rowCount == 0) {
+        return false;
+    }
+    prefix = sql.substr(0, valuesEnd);
+    rows = sql.substr(rowsStart, rowsEnd - rowsStart);
+    return true;
+}
+
+std::string statementFingerprint(const std::string& statement) {
+    // Only the head of long statements is read, so a multi-megabyte bulk
+    // insert costs no more than a short one
+    std::string head;
+    if (statement.size() > fingerprintMaxScan) {
+        head.assign(statement, 0, fingerprintMaxScan);
+    }
+    const std::string& sql = head.empty() ? statement : head;
+    std::string out;
+    out.reserve(sql.size() + 4);
+    bool pendingSpace = false;
+    // Per open parenthesis: whether it holds a list whose length doesn't
+    // matter (IN (...), a VALUES row, or a tuple within either)
+    std::vector<bool> lists;
+    // Depth whose parentheses are VALUES rows; -1 outside a VALUES clause
+    int valuesDepth = -1;
+    std::string lastWord;
+    size_t pos = skipSpace(sql, 0);
+    while (pos < sql.size()) {
+        size_t next = skipSpace(sql, pos);
+        if (next != pos) {
+            pendingSpace = true;
+            pos = next;
+            continue;
+        }
+        char c = sql[pos];
+        if (pendingSpace && c != ',' && c != ')' && !out.empty() && out.back() != '(') {
+            out += ' ';
+        }
+        pendingSpace = false;
+        bool inList = !lists.empty() && lists.back();
+        int depth = static_cast<int>(lists.size());
+
+        if (c == '\'' || c == '"') {
+            appendPlaceholder(out, inList);
+            pos = skipQuoted(sql, pos);
+        } else if (std::isdigit(static_cast<unsigned char>(c))) {
+            // Numeric literal, including 1.5e3 and 0x1F forms
+            while (pos < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[pos])) || sql[pos] == '.')) {
+                ++pos;
+            }
+            appendPlaceholder(out, inList);
+        } else if (c == '?') {
+            appendPlaceholder(out, inList);
+            ++pos;
+        } else if (isIdentifierChar(c)) {
+            size_t start = out.size();
+            while (pos < sql.size() && isIdentifierChar(sql[pos])) {
+                out += static_cast<char>(std::toupper(static_cast<unsigned char>(sql[pos])));
+                ++pos;
+            }
+            std::string word = out.substr(start);
+            if (word == "VALUES" || word == "VALUE") {
+                valuesDepth = depth;
+            } else if (depth == valuesDepth) {
+                valuesDepth = -1; // e.g. ON DUPLICATE KEY UPDATE
+            }
+            if (word == "SELECT" && inList) {
+                lists.back() = false; // IN (SELECT ...) is a subquery, not a list
+            }
+            lastWord = word;
+            continue;
+        } else {
+            out += c;
+            ++pos;
+            if (c == ',') {
+                pendingSpace = true;
+            } else if (c == '(') {
+                lists.push_back(lastWord == "IN" || depth == valuesDepth || inList);
+            } else if (c == ')' && !lists.empty()) {
+                lists.pop_back();
+                bool rows = (!lists.empty() && lists.back()) || static_cast<int>(lists.size()) == valuesDepth;
+                if (rows && endsWith(out, "(?), (?)")) {
+                    out.resize(out.size() - 5); // ", (?)"
+                }
+            }
+        }
+        lastWord.clear();
+    }
+    if (!head.empty()) {
+        // Drop a list the cut left open, so long IN lists and VALUES rows
+        // get the same fingerprint wherever the cut falls
+        size_t open = out.rfind('(');
+        size_t close = out.rfind(')');
+        if (open != std::string::npos && (close == std::string::npos || open > close)) {
+            out.resize(open);
+        }
+        while (!out.empty() && (out.back() == ' ' || out.back() == ',')) {
+            out.pop_back();
+        }
+        out += " ...";
+    }
+    return out;
+}
+
+uint64_t fingerprintHash(const std::string& fingerprint) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : fingerprint) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
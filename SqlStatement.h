@@ -0,0 +1,53 @@
+#ifndef SQL_STATEMENT_H
+#define SQL_STATEMENT_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Lightweight helpers for inspecting raw SQL text without a full parser.
+// They skip leading whitespace, comments and parentheses, and respect
+// quoted strings/identifiers when scanning.
+
+// Upper-cased first keyword of the statement, e.g. "SELECT" or "INSERT".
+std::string leadingKeyword(const std::string& sql);
+
+// How a statement should be executed.
+enum class StatementKind {
+    Query,  // returns a result set: SELECT, SHOW, DESCRIBE, EXPLAIN, ...
+    Update, // returns an affected row count: INSERT, REPLACE, UPDATE, DELETE, ...
+    Other   // anything else (DDL, SET, CALL, ...); may or may not return rows
+};
+
+StatementKind classifyStatement(const std::string& sql);
+
+// Adds a MySQL 8 "/*+ MAX_EXECUTION_TIME(ms) */" optimizer hint after the
+// leading SELECT so the server aborts the query itself once ms have passed.
+// Other statements are returned unchanged.
+std::string withMaxExecutionTime(const std::string& sql, long long ms);
+
+// True for INSERT, REPLACE, UPDATE and DELETE statements.
+bool isWriteStatement(const std::string& sql);
+
+// Target table of a write statement ("" when it can't be determined).
+std::string statementTable(const std::string& sql);
+
+// Splits "INSERT INTO t (a, b) VALUES (1, 2), (3, 4)" into the part up to and
+// including VALUES and the comma separated row tuples. Returns false when the
+// statement has anything after the tuples (ON DUPLICATE KEY UPDATE, SELECT
+// source, ...) and so can't be coalesced with other inserts.
+bool splitInsertValues(const std::string& sql, std::string& prefix, std::string& rows, size_t& rowCount);
+
+// Statement shape with literals replaced: comments dropped, whitespace
+// collapsed, keywords and identifiers upper-cased, strings and numbers
+// replaced by ?, and IN lists and VALUES rows collapsed to one entry.
+// "select * from t where id in (1, 2,3)" -> "SELECT * FROM T WHERE ID IN (?)"
+// Only the first fingerprintMaxScan bytes are read; fingerprints of longer
+// statements end in " ...".
+const size_t fingerprintMaxScan = 4096;
+std::string statementFingerprint(const std::string& sql);
+
+// 64-bit FNV-1a hash of a fingerprint, used as its key in statistics
+uint64_t fingerprintHash(const std::string& fingerprint);
+
+#endif
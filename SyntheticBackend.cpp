@@ -0,0 +1,169 @@
+#include "SyntheticBackend.h"
+#include "SqlStatement.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+    std::string trim(const std::string& s) {
+        size_t start = s.find_first_not_of(" \t");
+        if (start == std::string::npos) {
+            return "";
+        }
+        size_t end = s.find_last_not_of(" \t");
+        return s.substr(start, end - start + 1);
+    }
+
+    // Row count asked for by a trailing "LIMIT n", "LIMIT offset, n" or
+    // "LIMIT n OFFSET m"; -1 when there is none or it is a placeholder
+    long long statementLimit(const std::string& sql) {
+        static const char keyword[] = "LIMIT";
+        auto found = std::find_end(sql.begin(), sql.end(), keyword, keyword + 5,
+                                   [](char a, char b) { return std::toupper(static_cast<unsigned char>(a)) == b; });
+        size_t pos = found - sql.begin();
+        if (found == sql.end() || (pos > 0 && (std::isalnum(static_cast<unsigned char>(sql[pos - 1])) || sql[pos - 1] == '_'))) {
+            return -1;
+        }
+        const char* p = sql.c_str() + pos + 5;
+        char* end = nullptr;
+        long long limit = std::strtoll(p, &end, 10);
+        if (end == p) {
+            return -1;
+        }
+        while (*end == ' ' || *end == '\t' || *end == '\n') {
+            ++end;
+        }
+        if (*end == ',') {
+            p = end + 1;
+            limit = std::strtoll(p, &end, 10);
+            if (end == p) {
+                return -1;
+            }
+        }
+        return std::max(limit, 0LL);
+    }
+
+    std::string makeValue(SyntheticBackend::ColumnType type, size_t row, size_t column, size_t valueBytes) {
+        char text[32];
+        switch (type) {
+            case SyntheticBackend::ColumnType::Int:
+                return std::to_string(row + 1);
+            case SyntheticBackend::ColumnType::Double:
+                std::snprintf(text, sizeof(text), "%.4f", (row + 1) * 1.25 + column);
+                return text;
+            case SyntheticBackend::ColumnType::Datetime:
+                std::snprintf(text, sizeof(text), "2024-01-%02zu %02zu:%02zu:%02zu", row % 28 + 1, row % 24, row % 60, column % 60);
+                return text;
+            case SyntheticBackend::ColumnType::String:
+            default: {
+                std::string value(valueBytes, 'a');
+                // Vary the values a little so rows don't compress to nothing
+                for (size_t i = 0; i < value.size(); ++i) {
+                    value[i] = static_cast<char>('a' + (row * 7 + column * 3 + i) % 26);
+                }
+                return value;
+            }
+        }
+    }
+}
+
+class SyntheticSession : public QuerySession {
+public:
+    explicit SyntheticSession(SyntheticBackend& backend) : backend_(backend) {
+    }
+
+    uint64_t connectionId() override {
+        return 0; // nothing to kill
+    }
+
+    bool execute(const Request& request, const NamedQuery* named) override {
+        const std::string& sql = named ? named->sql : request.query;
+        if (backend_.latency_.count() > 0) {
+            std::this_thread::sleep_for(backend_.latency_);
+        }
+        StatementKind kind = named ? named->kind : classifyStatement(sql);
+        if (kind == StatementKind::Update) {
+            counts_.affectedRows = 1;
+            if (leadingKeyword(sql) == "INSERT" || leadingKeyword(sql) == "REPLACE") {
+                counts_.lastInsertId = ++backend_.lastInsertId_;
+            }
+            return false;
+        }
+        if (kind == StatementKind::Other) {
+            return false;
+        }
+        long long limit = statementLimit(sql);
+        rowCount_ = limit < 0 ? backend_.rows_.size() : std::min(static_cast<size_t>(limit), backend_.rows_.size());
+        return true;
+    }
+
+    void fetch(ResultRows& rows) override {
+        rows.insert(rows.end(), backend_.rows_.begin(), backend_.rows_.begin() + rowCount_);
+    }
+
+    UpdateCounts updateCounts() override {
+        return counts_;
+    }
+
+private:
+    SyntheticBackend& backend_;
+    size_t rowCount_ = 0;
+    UpdateCounts counts_;
+};
+
+std::vector<SyntheticBackend::Column> SyntheticBackend::parseColumns(const std::string& spec) {
+    std::vector<Column> columns;
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t comma = spec.find(',', start);
+        std::string entry = trim(spec.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        start = comma == std::string::npos ? spec.size() + 1 : comma + 1;
+        if (entry.empty()) {
+            continue;
+        }
+        size_t colon = entry.find(':');
+        Column column;
+        column.name = trim(entry.substr(0, colon));
+        std::string type = colon == std::string::npos ? "string" : trim(entry.substr(colon + 1));
+        if (column.name.empty()) {
+            throw std::invalid_argument("column without a name in \"" + entry + "\"");
+        }
+        if (type == "int") {
+            column.type = ColumnType::Int;
+        } else if (type == "double") {
+            column.type = ColumnType::Double;
+        } else if (type == "string") {
+            column.type = ColumnType::String;
+        } else if (type == "datetime") {
+            column.type = ColumnType::Datetime;
+        } else {
+            throw std::invalid_argument("unknown type \"" + type + "\" for column " + column.name +
+                                        " (expected int, double, string or datetime)");
+        }
+        columns.push_back(column);
+    }
+    if (columns.empty()) {
+        throw std::invalid_argument("no columns");
+    }
+    return columns;
+}
+
+SyntheticBackend::SyntheticBackend(const std::vector<Column>& columns, size_t rows, size_t valueBytes, std::chrono::microseconds latency)
+    : latency_(latency) {
+    rows_.reserve(rows);
+    for (size_t r = 0; r < rows; ++r) {
+        auto& row = rows_.emplace_back();
+        for (size_t c = 0; c < columns.size(); ++c) {
+            std::string value = makeValue(columns[c].type, r, c, valueBytes);
+            row.emplace(std::pmr::string(columns[c].name), std::pmr::string(value));
+        }
+    }
+}
+
+std::unique_ptr<QuerySession> SyntheticBackend::open(int) {
+    return std::unique_ptr<QuerySession>(new SyntheticSession(*this));
+}
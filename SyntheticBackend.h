@@ -0,0 +1,38 @@
+#ifndef SYNTHETIC_BACKEND_H
+#define SYNTHETIC_BACKEND_H
+
+#include "QueryBackend.h"
+#include <atomic>
+#include <chrono>
+
+// Answers queries with generated rows instead of running them, so the
+// receive, queueing, encoding and send paths can be benchmarked and
+// profiled without a database. A SELECT returns its LIMIT or the configured
+// number of rows, whichever is smaller; other statements report one
+// affected row. Every query waits latency first when it is non-zero.
+class SyntheticBackend : public QueryBackend {
+public:
+    enum class ColumnType { Int, Double, String, Datetime };
+
+    struct Column {
+        std::string name;
+        ColumnType type;
+    };
+
+    // "id:int,name:string,created_at:datetime"; throws std::invalid_argument
+    static std::vector<Column> parseColumns(const std::string& spec);
+
+    // valueBytes: length of string values
+    SyntheticBackend(const std::vector<Column>& columns, size_t rows, size_t valueBytes, std::chrono::microseconds latency);
+
+    std::unique_ptr<QuerySession> open(int bulkhead) override;
+
+private:
+    friend class SyntheticSession;
+
+    ResultRows rows_; // generated once; queries copy a prefix
+    std::chrono::microseconds latency_;
+    std::atomic<uint64_t> lastInsertId_{0};
+};
+
+#endif
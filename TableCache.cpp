@@ -0,0 +1,284 @@
+#include "TableCache.h"
+#include <cppconn/statement.h>
+#include <cppconn/resultset.h>
+#include <cppconn/exception.h>
+#include <algorithm>
+#include <cstdlib>
+#include "Logger.h"
+
+// A write storm reloads a table at most this often
+static const std::chrono::milliseconds minReloadInterval(100);
+
+namespace {
+
+bool isInteger(const std::string& text) {
+    if (text.empty() || text.size() > 19) {
+        return false;
+    }
+    size_t i = (text[0] == '-') ? 1 : 0;
+    if (i == text.size()) {
+        return false;
+    }
+    for (; i < text.size(); ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TableCache::TableCache(MySQLConnectionPool& pool, size_t bulkhead, const std::vector<CachedTableConfig>& tables)
+    : pool_(pool), bulkhead_(bulkhead) {
+    for (const CachedTableConfig& config : tables) {
+        std::unique_ptr<Table> table(new Table());
+        table->config = config;
+        load(*table);
+        tables_[config.table] = std::move(table);
+    }
+    if (!tables_.empty()) {
+        refreshThread_ = std::thread([this]() {
+            refreshLoop();
+        });
+    }
+}
+
+TableCache::~TableCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    refreshCondition_.notify_all();
+    if (refreshThread_.joinable()) {
+        refreshThread_.join();
+    }
+}
+
+std::string TableCache::value(const Snapshot& snapshot, size_t column, uint32_t row) {
+    const Column& c = snapshot.columns[column];
+    return c.data.substr(c.offsets[row], c.offsets[row + 1] - c.offsets[row]);
+}
+
+void TableCache::appendRow(const Snapshot& snapshot, uint32_t row, Rows& rows) {
+    std::map<std::string, std::string> values;
+    for (size_t i = 0; i < snapshot.columns.size(); ++i) {
+        values[snapshot.columns[i].name] = value(snapshot, i, row);
+    }
+    rows.push_back(std::move(values));
+}
+
+bool TableCache::lookup(const std::string& table, const std::string& column, const std::string& key, Rows& rows) const {
+    auto it = tables_.find(table);
+    if (it == tables_.end()) {
+        return false;
+    }
+    std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&it->second->snapshot);
+    if (!snapshot) {
+        return false;
+    }
+    if (column.empty() || column == it->second->config.key) {
+        auto row = snapshot->primary.find(key);
+        if (row != snapshot->primary.end()) {
+            appendRow(*snapshot, row->second, rows);
+        }
+    } else {
+        auto index = snapshot->indexes.find(column);
+        if (index == snapshot->indexes.end()) {
+            return false;
+        }
+        auto matches = index->second.equal_range(key);
+        for (auto row = matches.first; row != matches.second; ++row) {
+            appendRow(*snapshot, row->second, rows);
+        }
+    }
+    ++it->second->hits;
+    return true;
+}
+
+bool TableCache::range(const std::string& table, const std::string& low, const std::string& high, Rows& rows) const {
+    auto it = tables_.find(table);
+    if (it == tables_.end()) {
+        return false;
+    }
+    std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&it->second->snapshot);
+    if (!snapshot) {
+        return false;
+    }
+    const Snapshot& s = *snapshot;
+    bool numeric = s.numericKeys && isInteger(low) && isInteger(high);
+    long long lowNumber = numeric ? std::atoll(low.c_str()) : 0;
+    long long highNumber = numeric ? std::atoll(high.c_str()) : 0;
+    auto first = std::lower_bound(s.keyOrder.begin(), s.keyOrder.end(), low, [&](uint32_t row, const std::string& bound) {
+        std::string key = value(s, s.keyColumn, row);
+        return numeric ? std::atoll(key.c_str()) < lowNumber : key < bound;
+    });
+    for (auto row = first; row != s.keyOrder.end(); ++row) {
+        std::string key = value(s, s.keyColumn, *row);
+        if (numeric ? std::atoll(key.c_str()) > highNumber : key > high) {
+            break;
+        }
+        appendRow(s, *row, rows);
+    }
+    ++it->second->hits;
+    return true;
+}
+
+void TableCache::invalidate(const std::string& table) {
+    auto it = tables_.find(table);
+    if (it == tables_.end()) {
+        return;
+    }
+    if (!it->second->dirty.exchange(true)) {
+        {
+            // Pairs with the predicate check in refreshLoop so the wakeup isn't lost
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        refreshCondition_.notify_one();
+    }
+}
+
+std::vector<TableCache::TableStats> TableCache::stats() const {
+    std::vector<TableStats> result;
+    for (const auto& entry : tables_) {
+        const Table& table = *entry.second;
+        std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&table.snapshot);
+        TableStats s;
+        s.table = entry.first;
+        s.rows = snapshot ? snapshot->rows : 0;
+        s.loads = table.loads;
+        s.hits = table.hits;
+        s.lastLoadMs = table.lastLoadMs;
+        result.push_back(s);
+    }
+    return result;
+}
+
+void TableCache::load(Table& table) {
+    auto start = std::chrono::steady_clock::now();
+    table.nextRefresh = start + std::chrono::seconds(table.config.refreshSeconds);
+    table.dirty = false;
+
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    sql::Connection* conn = nullptr;
+    try {
+        conn = pool_.getConnection(bulkhead_);
+        std::unique_ptr<sql::Statement> stmt(conn->createStatement());
+        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT * FROM " + table.config.table));
+
+        sql::ResultSetMetaData* meta = res->getMetaData();
+        unsigned int columnCount = meta->getColumnCount();
+        std::vector<int> indexColumns;
+        bool keyFound = false;
+        for (unsigned int i = 1; i <= columnCount; ++i) {
+            Column column;
+            column.name = meta->getColumnLabel(i);
+            column.offsets.push_back(0);
+            if (column.name == table.config.key) {
+                snapshot->keyColumn = i - 1;
+                keyFound = true;
+            }
+            if (std::find(table.config.indexes.begin(), table.config.indexes.end(), column.name) != table.config.indexes.end()) {
+                indexColumns.push_back(i - 1);
+                snapshot->indexes[column.name];
+            }
+            snapshot->columns.push_back(std::move(column));
+        }
+        if (!keyFound) {
+            throw std::runtime_error("key column " + table.config.key + " not found");
+        }
+
+        size_t rowCount = res->rowsCount();
+        for (Column& column : snapshot->columns) {
+            column.offsets.reserve(rowCount + 1);
+        }
+        uint32_t row = 0;
+        while (res->next()) {
+            for (unsigned int i = 1; i <= columnCount; ++i) {
+                Column& column = snapshot->columns[i - 1];
+                std::string cell = res->getString(i);
+                column.data += cell;
+                column.offsets.push_back(static_cast<uint32_t>(column.data.size()));
+            }
+            std::string key = value(*snapshot, snapshot->keyColumn, row);
+            snapshot->numericKeys = snapshot->numericKeys && isInteger(key);
+            snapshot->primary[key] = row;
+            for (int column : indexColumns) {
+                snapshot->indexes[snapshot->columns[column].name].emplace(value(*snapshot, column, row), row);
+            }
+            ++row;
+        }
+        snapshot->rows = row;
+
+        snapshot->keyOrder.resize(row);
+        for (uint32_t i = 0; i < row; ++i) {
+            snapshot->keyOrder[i] = i;
+        }
+        if (snapshot->numericKeys) {
+            std::vector<long long> keys(row);
+            for (uint32_t i = 0; i < row; ++i) {
+                keys[i] = std::atoll(value(*snapshot, snapshot->keyColumn, i).c_str());
+            }
+            std::sort(snapshot->keyOrder.begin(), snapshot->keyOrder.end(), [&keys](uint32_t a, uint32_t b) {
+                return keys[a] < keys[b];
+            });
+        } else {
+            std::vector<std::string> keys(row);
+            for (uint32_t i = 0; i < row; ++i) {
+                keys[i] = value(*snapshot, snapshot->keyColumn, i);
+            }
+            std::sort(snapshot->keyOrder.begin(), snapshot->keyOrder.end(), [&keys](uint32_t a, uint32_t b) {
+                return keys[a] < keys[b];
+            });
+        }
+    } catch (const std::exception &e) {
+        Logger::instance().log(LogLevel::Error, "Failed to load cached table", {{"table", table.config.table}, {"error", e.what()}});
+        snapshot.reset();
+    }
+    if (conn) {
+        pool_.releaseConnection(conn, bulkhead_);
+    }
+    if (!snapshot) {
+        // Keep serving the previous snapshot, if any
+        return;
+    }
+
+    std::atomic_store(&table.snapshot, std::shared_ptr<const Snapshot>(snapshot));
+    ++table.loads;
+    table.lastLoadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TableCache::refreshLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        auto now = std::chrono::steady_clock::now();
+        auto wake = now + std::chrono::seconds(60);
+        for (auto& entry : tables_) {
+            Table& table = *entry.second;
+            if (table.dirty || now >= table.nextRefresh) {
+                lock.unlock();
+                load(table);
+                lock.lock();
+                now = std::chrono::steady_clock::now();
+            }
+            wake = std::min(wake, table.nextRefresh);
+        }
+        refreshCondition_.wait_until(lock, wake, [this] {
+            if (!running_) {
+                return true;
+            }
+            for (auto& entry : tables_) {
+                if (entry.second->dirty) {
+                    return true;
+                }
+            }
+            return false;
+        });
+        if (running_) {
+            // Let a burst of writes settle before reloading
+            lock.unlock();
+            std::this_thread::sleep_for(minReloadInterval);
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef TABLE_CACHE_H
+#define TABLE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include "mySQLConnectionPool.h"
+#include "QueryRegistry.h"
+
+// In-memory copies of small, read-mostly tables. Each table is loaded with
+// SELECT * into a columnar snapshot (one contiguous buffer per column) with a
+// hash index on the primary key, optional secondary hash indexes and a sorted
+// key order for range lookups. Lookups read an immutable snapshot and never
+// touch the connection pool; a background thread rebuilds a table every
+// refresh_seconds, or shortly after invalidate() reports a write to it.
+class TableCache {
+public:
+    typedef std::vector<std::map<std::string, std::string>> Rows;
+
+    struct TableStats {
+        std::string table;
+        size_t rows;
+        uint64_t loads;
+        uint64_t hits;
+        double lastLoadMs;
+    };
+
+    // Loads and refreshes run on connections from the pool's given bulkhead
+    TableCache(MySQLConnectionPool& pool, size_t bulkhead, const std::vector<CachedTableConfig>& tables);
+    ~TableCache();
+
+    // Rows where column = key. column must be the primary key or an indexed
+    // column. Returns false when the table isn't cached or loaded, or the
+    // column has no index.
+    bool lookup(const std::string& table, const std::string& column, const std::string& key, Rows& rows) const;
+    // Rows with low <= primary key <= high, in key order. Keys compare
+    // numerically when every key in the table is an integer.
+    bool range(const std::string& table, const std::string& low, const std::string& high, Rows& rows) const;
+    // Marks a table as stale after a write; unknown tables are ignored.
+    void invalidate(const std::string& table);
+    bool contains(const std::string& table) const { return tables_.count(table) > 0; }
+    std::vector<TableStats> stats() const;
+
+private:
+    struct Column {
+        std::string name;
+        std::string data;              // every value back to back
+        std::vector<uint32_t> offsets; // row i is data[offsets[i], offsets[i + 1])
+    };
+    struct Snapshot {
+        std::vector<Column> columns;
+        size_t rows = 0;
+        std::unordered_map<std::string, uint32_t> primary;
+        std::map<std::string, std::unordered_multimap<std::string, uint32_t>> indexes;
+        std::vector<uint32_t> keyOrder; // rows sorted by primary key
+        bool numericKeys = true;
+        size_t keyColumn = 0;
+    };
+    struct Table {
+        CachedTableConfig config;
+        std::shared_ptr<const Snapshot> snapshot; // std::atomic_load/atomic_store only
+        std::atomic<bool> dirty{false};
+        std::chrono::steady_clock::time_point nextRefresh;
+        std::atomic<uint64_t> loads{0};
+        mutable std::atomic<uint64_t> hits{0};
+        std::atomic<double> lastLoadMs{0};
+    };
+
+    void load(Table& table);
+    void refreshLoop();
+    static std::string value(const Snapshot& snapshot, size_t column, uint32_t row);
+    static void appendRow(const Snapshot& snapshot, uint32_t row, Rows& rows);
+
+private:
+    MySQLConnectionPool& pool_;
+    size_t bulkhead_;
+    std::map<std::string, std::unique_ptr<Table>> tables_; // fixed after construction
+    std::mutex mutex_;
+    std::condition_variable refreshCondition_;
+    std::thread refreshThread_;
+    bool running_ = true;
+};
+
+#endif
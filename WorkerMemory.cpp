@@ -0,0 +1,72 @@
+#include "WorkerMemory.h"
+#include <algorithm>
+
+namespace {
+    const size_t minReplyBuffer = 64 * 1024;
+    const size_t minArenaBlock = 64 * 1024;
+    // Largest block an arena keeps between requests; bigger requests pay
+    // for heap allocations rather than pinning the memory per worker
+    const size_t maxArenaBlock = 16 * 1024 * 1024;
+}
+
+ReplyBuffer& ReplyBuffer::forThread() {
+    thread_local ReplyBuffer buffer;
+    return buffer;
+}
+
+ReplyBuffer::ReplyBuffer() : buffer_(new msgpack::sbuffer(minReplyBuffer)), estimate_(minReplyBuffer) {
+}
+
+msgpack::sbuffer& ReplyBuffer::take() {
+    // Shrink a buffer several times bigger than what replies need lately
+    if (peak_ > 4 * estimate_ && peak_ > 4 * minReplyBuffer) {
+        buffer_.reset(new msgpack::sbuffer(std::max(static_cast<size_t>(2 * estimate_), minReplyBuffer)));
+        peak_ = 0;
+    }
+    buffer_->clear();
+    return *buffer_;
+}
+
+void ReplyBuffer::done(size_t replyBytes) {
+    estimate_ += (static_cast<double>(replyBytes) - estimate_) / 16;
+    peak_ = std::max(peak_, replyBytes);
+}
+
+RequestArena& RequestArena::forThread() {
+    thread_local RequestArena arena;
+    return arena;
+}
+
+RequestArena::RequestArena()
+    : block_(new char[minArenaBlock]), blockSize_(minArenaBlock), estimate_(minArenaBlock),
+      overflow_(std::pmr::new_delete_resource()), requested_(nullptr) {
+    arena_.emplace(block_.get(), blockSize_, &overflow_);
+    requested_.upstream = &*arena_;
+}
+
+void RequestArena::reset() {
+    arena_.reset();
+    estimate_ += (static_cast<double>(requested_.bytes) - estimate_) / 16;
+    if (overflow_.bytes > 0 && blockSize_ < maxArenaBlock) {
+        // Next time, fit everything this request needed into the block
+        blockSize_ = std::min(maxArenaBlock, blockSize_ + overflow_.bytes);
+        block_.reset(new char[blockSize_]);
+    } else if (blockSize_ > 4 * estimate_ && blockSize_ > 4 * minArenaBlock) {
+        // Shrink a block several times bigger than what requests need lately
+        blockSize_ = std::max(static_cast<size_t>(2 * estimate_), minArenaBlock);
+        block_.reset(new char[blockSize_]);
+    }
+    overflow_.bytes = 0;
+    requested_.bytes = 0;
+    arena_.emplace(block_.get(), blockSize_, &overflow_);
+    requested_.upstream = &*arena_;
+}
+
+void* RequestArena::Counted::do_allocate(size_t size, size_t alignment) {
+    bytes += size;
+    return upstream->allocate(size, alignment);
+}
+
+void RequestArena::Counted::do_deallocate(void* p, size_t size, size_t alignment) {
+    upstream->deallocate(p, size, alignment);
+}
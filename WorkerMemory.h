@@ -0,0 +1,70 @@
+#ifndef WORKER_MEMORY_H
+#define WORKER_MEMORY_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <msgpack.hpp>
+
+// Memory a worker thread reuses from one request to the next, so a request
+// in steady state doesn't touch the global allocator.
+
+// The reply buffer. take() hands out the thread's sbuffer, emptied but with
+// its capacity kept; done() records how big the reply was. A buffer that
+// grew for a rare huge reply is given back once replies are back to normal,
+// instead of holding on to megabytes per worker.
+class ReplyBuffer {
+public:
+    static ReplyBuffer& forThread();
+
+    msgpack::sbuffer& take();
+    void done(size_t replyBytes);
+
+private:
+    ReplyBuffer();
+
+    std::unique_ptr<msgpack::sbuffer> buffer_;
+    double estimate_;    // moving average of reply sizes
+    size_t peak_ = 0;    // largest reply since the buffer was (re)made, a lower bound on its capacity
+};
+
+// Bump allocator for per-request temporaries (result rows and their
+// strings). Allocations are never freed one by one; reset() after the reply
+// is sent drops them all. The arena starts from one block sized to what
+// recent requests used and grows from the heap only past it; the next
+// reset() then sizes the block up. Like the reply buffer, a block grown for
+// a rare huge request is given back once requests are back to normal.
+class RequestArena {
+public:
+    static RequestArena& forThread();
+
+    std::pmr::memory_resource* resource() { return &requested_; }
+    void reset();
+
+private:
+    // Forwards to another resource and counts the bytes allocated through it
+    class Counted : public std::pmr::memory_resource {
+    public:
+        explicit Counted(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+
+        std::pmr::memory_resource* upstream;
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t alignment) override;
+        void do_deallocate(void* p, size_t size, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    RequestArena();
+
+    std::unique_ptr<char[]> block_;
+    size_t blockSize_;
+    double estimate_;                    // moving average of bytes a request allocated
+    Counted overflow_;                   // what the arena took beyond its block
+    std::optional<std::pmr::monotonic_buffer_resource> arena_;
+    Counted requested_;                  // what the request took from the arena
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+
+WorkerPool::WorkerPool(Body body, std::function<void()> wake) : body_(body), wake_(wake) {
+}
+
+WorkerPool::~WorkerPool() {
+    resize(0);
+}
+
+void WorkerPool::resize(int size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size = std::max(0, size);
+    while (static_cast<int>(workers_.size()) < size) {
+        Worker worker;
+        worker.stop.reset(new std::atomic<bool>(false));
+        worker.done.reset(new std::atomic<bool>(false));
+        const std::atomic<bool>& stop = *worker.stop;
+        std::atomic<bool>& done = *worker.done;
+        worker.thread = std::thread([this, &stop, &done]() {
+            body_(stop);
+            done = true;
+        });
+        workers_.push_back(std::move(worker));
+    }
+    if (static_cast<int>(workers_.size()) > size) {
+        for (size_t i = size; i < workers_.size(); ++i) {
+            *workers_[i].stop = true;
+        }
+        // A worker may start waiting for work just after a wake-up, so keep
+        // waking until every retired worker has left its loop
+        for (size_t i = size; i < workers_.size(); ++i) {
+            while (!*workers_[i].done) {
+                wake_();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            workers_[i].thread.join();
+        }
+        workers_.resize(size);
+    }
+    size_ = size;
+}
+
+int WorkerPool::size() {
+    return size_;
+}
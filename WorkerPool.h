@@ -0,0 +1,41 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+// A resizable set of worker threads running the same loop. Each thread gets
+// a stop flag it must check between requests; shrinking sets the flags of the
+// newest threads, calls wake so threads blocked waiting for work notice, and
+// joins them once their current request is done, so nothing in flight is
+// dropped.
+class WorkerPool {
+public:
+    typedef std::function<void(const std::atomic<bool>& stop)> Body;
+
+    WorkerPool(Body body, std::function<void()> wake);
+    ~WorkerPool();
+
+    // Blocks until retired workers have finished their current request
+    void resize(int size);
+    int size();
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::unique_ptr<std::atomic<bool>> stop;
+        std::unique_ptr<std::atomic<bool>> done;
+    };
+
+    Body body_;
+    std::function<void()> wake_;
+    std::vector<Worker> workers_;
+    std::atomic<int> size_{0}; // readable while a resize waits on workers
+    std::mutex mutex_;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "WriteBehindBuffer.h"
+#include "SqlStatement.h"
+#include <cppconn/statement.h>
+#include <cppconn/exception.h>
+#include "Logger.h"
+#include <memory>
+
+// Writers block once this many flushes worth of rows are waiting.
+static const size_t maxBufferedFlushes = 8;
+
+WriteBehindBuffer::WriteBehindBuffer(MySQLConnectionPool& pool, size_t bulkhead, int flushIntervalMs, size_t maxRows)
+    : pool_(pool), bulkhead_(bulkhead), flushInterval_(flushIntervalMs), maxRows_(maxRows) {
+    flushThread_ = std::thread([this]() {
+        flushLoop();
+    });
+}
+
+WriteBehindBuffer::~WriteBehindBuffer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    flushCondition_.notify_all();
+    if (flushThread_.joinable()) {
+        flushThread_.join();
+    }
+}
+
+bool WriteBehindBuffer::enqueue(const std::string& sql, Completion done) {
+    if (!isWriteStatement(sql)) {
+        return false;
+    }
+    std::string prefix, rows;
+    size_t rowCount = 1;
+    if (!splitInsertValues(sql, prefix, rows, rowCount)) {
+        rowCount = 1;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    spaceCondition_.wait(lock, [this] {
+        return pendingRows_ < maxRows_ * maxBufferedFlushes || !running_;
+    });
+    std::string table = statementTable(sql);
+    auto index = tableIndex_.find(table);
+    if (index == tableIndex_.end()) {
+        index = tableIndex_.emplace(table, tables_.size()).first;
+        tables_.emplace_back(table, std::vector<PendingWrite>());
+    }
+    tables_[index->second].second.push_back(PendingWrite{sql, rowCount, std::move(done)});
+    ++pendingWrites_;
+    pendingRows_ += rowCount;
+    if (pendingRows_ >= maxRows_) {
+        flushCondition_.notify_one();
+    }
+    return true;
+}
+
+WriteBehindBuffer::Stats WriteBehindBuffer::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s;
+    s.pendingWrites = pendingWrites_;
+    s.pendingRows = pendingRows_;
+    s.flushes = flushes_;
+    s.failedFlushes = failedFlushes_;
+    s.flushedWrites = flushedWrites_;
+    s.flushedRows = flushedRows_;
+    s.flushedStatements = flushedStatements_;
+    s.lastFlushMs = lastFlushMs_;
+    s.maxFlushMs = maxFlushMs_;
+    s.avgFlushMs = flushes_ ? totalFlushMs_ / flushes_ : 0;
+    return s;
+}
+
+void WriteBehindBuffer::flushLoop() {
+    while (true) {
+        TableWrites batch;
+        size_t rows = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            flushCondition_.wait_for(lock, flushInterval_, [this] {
+                return pendingRows_ >= maxRows_ || !running_;
+            });
+            if (pendingWrites_ == 0) {
+                if (!running_) {
+                    return;
+                }
+                continue;
+            }
+            batch.swap(tables_);
+            tableIndex_.clear();
+            rows = pendingRows_;
+            pendingWrites_ = 0;
+            pendingRows_ = 0;
+        }
+        spaceCondition_.notify_all();
+        flush(batch, rows);
+    }
+}
+
+// Merges runs of INSERTs sharing the same "INSERT INTO t (cols) VALUES" prefix
+// into one multi-row INSERT. Other statements are kept in their original order.
+std::vector<std::string> WriteBehindBuffer::coalesce(const std::vector<PendingWrite>& writes) {
+    std::vector<std::string> statements;
+    std::string runPrefix;
+    std::string runRows;
+    size_t runRowCount = 0;
+    for (const PendingWrite& write : writes) {
+        std::string prefix, rows;
+        size_t rowCount = 0;
+        if (splitInsertValues(write.sql, prefix, rows, rowCount)) {
+            if (runRowCount > 0 && prefix == runPrefix && runRowCount + rowCount <= maxRows_) {
+                runRows += ", ";
+                runRows += rows;
+                runRowCount += rowCount;
+                continue;
+            }
+            if (runRowCount > 0) {
+                statements.push_back(runPrefix + " " + runRows);
+            }
+            runPrefix = prefix;
+            runRows = rows;
+            runRowCount = rowCount;
+            continue;
+        }
+        if (runRowCount > 0) {
+            statements.push_back(runPrefix + " " + runRows);
+            runRowCount = 0;
+        }
+        statements.push_back(write.sql);
+    }
+    if (runRowCount > 0) {
+        statements.push_back(runPrefix + " " + runRows);
+    }
+    return statements;
+}
+
+void WriteBehindBuffer::complete(TableWrites& batch, const std::string& error) {
+    for (auto& table : batch) {
+        for (PendingWrite& write : table.second) {
+            if (write.done) {
+                write.done(error);
+            }
+        }
+    }
+}
+
+void WriteBehindBuffer::flush(TableWrites& batch, size_t rows) {
+    auto start = std::chrono::steady_clock::now();
+    size_t writes = 0;
+    for (auto& table : batch) {
+        writes += table.second.size();
+    }
+    size_t statementCount = 0;
+    bool failed = false;
+    bool committed = false;
+    sql::Connection* conn = nullptr;
+    try {
+        conn = pool_.getConnection(bulkhead_);
+        std::unique_ptr<sql::Statement> stmt(conn->createStatement());
+        conn->setAutoCommit(false);
+        try {
+            for (auto& table : batch) {
+                for (const std::string& statement : coalesce(table.second)) {
+                    stmt->execute(statement);
+                    ++statementCount;
+                }
+            }
+            conn->commit();
+            committed = true;
+        } catch (sql::SQLException &e) {
+            // One bad write must not sink the whole group: roll back and
+            // replay each write on its own so only the offender fails.
+            Logger::instance().log(LogLevel::Warn, "Write-behind flush failed, replaying writes individually", {{"error", e.what()}});
+            failed = true;
+            conn->rollback();
+            conn->setAutoCommit(true);
+            statementCount = 0;
+            for (auto& table : batch) {
+                for (PendingWrite& write : table.second) {
+                    std::string error;
+                    try {
+                        stmt->execute(write.sql);
+                        ++statementCount;
+                    } catch (sql::SQLException &writeError) {
+                        error = writeError.what();
+                        Logger::instance().log(LogLevel::Error, "Write-behind write failed",
+                                               {{"fingerprint", statementFingerprint(write.sql)}, {"error", error}});
+                    }
+                    if (write.done) {
+                        write.done(error);
+                    }
+                }
+            }
+        }
+    } catch (const std::exception &e) {
+        Logger::instance().log(LogLevel::Error, "Write-behind flush error", {{"error", e.what()}});
+        failed = true;
+        complete(batch, e.what());
+    }
+    if (committed) {
+        // The writes are in; whatever fails from here on must not replay them
+        complete(batch, "");
+        try {
+            conn->setAutoCommit(true);
+        } catch (sql::SQLException &e) {
+            // Don't hand a connection stuck outside autocommit back to the
+            // pool; a closed one is dropped on release
+            Logger::instance().log(LogLevel::Warn, "Write-behind connection reset failed", {{"error", e.what()}});
+            try {
+                conn->close();
+            } catch (sql::SQLException &) {
+            }
+        }
+    }
+    if (conn) {
+        pool_.releaseConnection(conn, bulkhead_);
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++flushes_;
+    if (failed) {
+        ++failedFlushes_;
+    }
+    flushedWrites_ += writes;
+    flushedRows_ += rows;
+    flushedStatements_ += statementCount;
+    lastFlushMs_ = elapsedMs;
+    if (elapsedMs > maxFlushMs_) {
+        maxFlushMs_ = elapsedMs;
+    }
+    totalFlushMs_ += elapsedMs;
+}
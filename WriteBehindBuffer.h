@@ -0,0 +1,89 @@
+#ifndef WRITE_BEHIND_BUFFER_H
+#define WRITE_BEHIND_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include "mySQLConnectionPool.h"
+
+// Buffers fire-and-forget writes per table and flushes them as a single
+// transaction, merging consecutive INSERTs into multi-row statements. Tables
+// are flushed in the order their first write arrived, so a parent row
+// buffered before its children is written first.
+// A flush happens every flushIntervalMs or as soon as maxRows rows are
+// pending, so many small writes share one commit on the database.
+class WriteBehindBuffer {
+public:
+    // Called once the write's batch has been committed. error is empty on
+    // success and holds the SQL error message otherwise.
+    typedef std::function<void(const std::string& error)> Completion;
+
+    struct Stats {
+        size_t pendingWrites;
+        size_t pendingRows;
+        uint64_t flushes;
+        uint64_t failedFlushes;
+        uint64_t flushedWrites;
+        uint64_t flushedRows;
+        uint64_t flushedStatements;
+        double lastFlushMs;
+        double maxFlushMs;
+        double avgFlushMs;
+    };
+
+    // Flushes run on connections from the pool's given bulkhead
+    WriteBehindBuffer(MySQLConnectionPool& pool, size_t bulkhead, int flushIntervalMs, size_t maxRows);
+    ~WriteBehindBuffer();
+
+    // Buffers a write statement. Returns false (and buffers nothing) when the
+    // statement isn't an INSERT/REPLACE/UPDATE/DELETE. Blocks while the buffer
+    // holds more than a few flushes worth of rows.
+    bool enqueue(const std::string& sql, Completion done);
+    Stats stats();
+
+private:
+    struct PendingWrite {
+        std::string sql;
+        size_t rows;
+        Completion done;
+    };
+    // Per table, in order of the table's first write
+    typedef std::vector<std::pair<std::string, std::vector<PendingWrite>>> TableWrites;
+
+    void flushLoop();
+    void flush(TableWrites& batch, size_t rows);
+    std::vector<std::string> coalesce(const std::vector<PendingWrite>& writes);
+    void complete(TableWrites& batch, const std::string& error);
+
+private:
+    MySQLConnectionPool& pool_;
+    size_t bulkhead_;
+    std::chrono::milliseconds flushInterval_;
+    size_t maxRows_;
+    TableWrites tables_;
+    std::unordered_map<std::string, size_t> tableIndex_; // position in tables_
+    size_t pendingWrites_ = 0;
+    size_t pendingRows_ = 0;
+    uint64_t flushes_ = 0;
+    uint64_t failedFlushes_ = 0;
+    uint64_t flushedWrites_ = 0;
+    uint64_t flushedRows_ = 0;
+    uint64_t flushedStatements_ = 0;
+    double lastFlushMs_ = 0;
+    double maxFlushMs_ = 0;
+    double totalFlushMs_ = 0;
+    std::mutex mutex_;
+    std::condition_variable flushCondition_;
+    std::condition_variable spaceCondition_;
+    std::thread flushThread_;
+    bool running_ = true;
+};
+
+#endif
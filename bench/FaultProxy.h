@@ -0,0 +1,253 @@
+#ifndef FAULT_PROXY_H
+#define FAULT_PROXY_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// A TCP proxy on 127.0.0.1 that forwards to an upstream server (MySQL or
+// MariaDB for the pool benchmarks) and misbehaves on request:
+//   Pass       forward untouched
+//   Latency    wait value ms before forwarding each chunk of data
+//   Flaky      reset a connection with value percent probability per chunk
+//   Reset      reset every open connection once, then pass (a server restart)
+//   Down       reset open connections and refuse new ones
+//   Blackhole  accept and hold connections but forward nothing; connections
+//              held when the fault ends are reset, as their data was lost
+// "Reset" closes with SO_LINGER 0 so the peer sees ECONNRESET. One thread
+// per connection; meant for tens of connections, not thousands.
+class FaultProxy {
+public:
+    enum class Mode { Pass, Latency, Flaky, Reset, Down, Blackhole };
+
+    // listenPort 0 picks a free port; see port()
+    FaultProxy(const std::string& upstreamHost, uint16_t upstreamPort, uint16_t listenPort = 0) {
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found = nullptr;
+        if (getaddrinfo(upstreamHost.c_str(), std::to_string(upstreamPort).c_str(), &hints, &found) != 0 || !found) {
+            throw std::runtime_error("cannot resolve " + upstreamHost);
+        }
+        std::memcpy(&upstream_, found->ai_addr, sizeof(upstream_));
+        freeaddrinfo(found);
+
+        listener_ = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(listenPort);
+        socklen_t length = sizeof(address);
+        if (bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener_, 128) != 0 ||
+            getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            close(listener_);
+            throw std::runtime_error(std::string("cannot listen: ") + std::strerror(errno));
+        }
+        port_ = ntohs(address.sin_port);
+        acceptThread_ = std::thread(&FaultProxy::acceptLoop, this);
+    }
+
+    ~FaultProxy() {
+        stop_ = true;
+        acceptThread_.join();
+        close(listener_);
+        std::list<std::shared_ptr<Link>> links;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            links.swap(links_);
+        }
+        for (auto& link : links) {
+            link->kill = true;
+            link->thread.join();
+        }
+    }
+
+    uint16_t port() const { return port_; }
+
+    // value: milliseconds for Latency, percent for Flaky, unused otherwise
+    void setFault(Mode mode, int value = 0) {
+        value_ = value;
+        if (mode == Mode::Reset || mode == Mode::Down) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& link : links_) {
+                link->kill = true;
+            }
+        }
+        mode_ = mode == Mode::Reset ? Mode::Pass : mode;
+    }
+
+    uint64_t accepted() const { return accepted_; }
+    uint64_t resets() const { return resets_; }
+
+private:
+    struct Link {
+        int client = -1;
+        int upstream = -1;
+        std::atomic<bool> kill{false};
+        std::atomic<bool> done{false};
+        std::thread thread;
+    };
+
+    static void resetSocket(int fd) {
+        linger hard = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &hard, sizeof(hard));
+        close(fd);
+    }
+
+    static bool writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    void acceptLoop() {
+        while (!stop_) {
+            pollfd item = {listener_, POLLIN, 0};
+            if (poll(&item, 1, 50) <= 0) {
+                reap();
+                continue;
+            }
+            int client = accept(listener_, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            ++accepted_;
+            if (mode_ == Mode::Down) {
+                resetSocket(client);
+                ++resets_;
+                continue;
+            }
+            int upstream = socket(AF_INET, SOCK_STREAM, 0);
+            if (connect(upstream, reinterpret_cast<const sockaddr*>(&upstream_), sizeof(upstream_)) != 0) {
+                close(upstream);
+                resetSocket(client);
+                ++resets_;
+                continue;
+            }
+            int on = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            setsockopt(upstream, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            std::shared_ptr<Link> link = std::make_shared<Link>();
+            link->client = client;
+            link->upstream = upstream;
+            link->thread = std::thread(&FaultProxy::pump, this, link.get());
+            std::lock_guard<std::mutex> lock(mutex_);
+            links_.push_back(link);
+        }
+    }
+
+    // Joins the threads of closed connections
+    void reap() {
+        std::list<std::shared_ptr<Link>> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = links_.begin(); it != links_.end();) {
+                if ((*it)->done) {
+                    finished.push_back(*it);
+                    it = links_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (auto& link : finished) {
+            link->thread.join();
+        }
+    }
+
+    void pump(Link* link) {
+        std::mt19937 random(std::random_device{}());
+        std::vector<char> buffer(64 * 1024);
+        bool held = false;
+        bool reset = false;
+        while (true) {
+            Mode mode = mode_;
+            if (link->kill || (held && mode != Mode::Blackhole)) {
+                reset = true;
+                break;
+            }
+            if (mode == Mode::Blackhole) {
+                held = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            pollfd items[] = {{link->client, POLLIN, 0}, {link->upstream, POLLIN, 0}};
+            if (poll(items, 2, 20) <= 0) {
+                continue;
+            }
+            bool closed = false;
+            for (int i = 0; i < 2 && !closed; ++i) {
+                if (!(items[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                    continue;
+                }
+                ssize_t size = recv(items[i].fd, buffer.data(), buffer.size(), 0);
+                if (size <= 0) {
+                    closed = true;
+                    break;
+                }
+                if (mode == Mode::Latency && value_ > 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(value_.load()));
+                } else if (mode == Mode::Flaky && static_cast<int>(random() % 100) < value_) {
+                    reset = true;
+                    closed = true;
+                    break;
+                }
+                if (!writeAll(i == 0 ? link->upstream : link->client, buffer.data(), static_cast<size_t>(size))) {
+                    closed = true;
+                }
+            }
+            if (closed) {
+                break;
+            }
+        }
+        if (reset) {
+            resetSocket(link->client);
+            resetSocket(link->upstream);
+            ++resets_;
+        } else {
+            close(link->client);
+            close(link->upstream);
+        }
+        link->done = true;
+    }
+
+    sockaddr_in upstream_;
+    int listener_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<Mode> mode_{Mode::Pass};
+    std::atomic<int> value_{0};
+    std::atomic<bool> stop_{false};
+    std::atomic<uint64_t> accepted_{0};
+    std::atomic<uint64_t> resets_{0};
+    std::mutex mutex_;
+    std::list<std::shared_ptr<Link>> links_;
+    std::thread acceptThread_;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// High Dynamic Range histogram after Gil Tene's HdrHistogram: values from 1
+// to highestTrackable are counted with a relative error under
+// 10^-significantDigits, in log2-sized buckets of linearly spaced
+// sub-buckets. Used by the benchmark tools for latencies in microseconds.
+// Not thread safe; give each thread its own and merge() them.
+class HdrHistogram {
+public:
+    explicit HdrHistogram(int64_t highestTrackable = 3600LL * 1000000, int significantDigits = 3)
+        : highestTrackable_(highestTrackable) {
+        int64_t singleUnitResolution = 2 * static_cast<int64_t>(std::pow(10, significantDigits));
+        int subBucketCountMagnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(singleUnitResolution))));
+        subBucketHalfCountMagnitude_ = std::max(subBucketCountMagnitude, 1) - 1;
+        subBucketCount_ = int64_t(1) << (subBucketHalfCountMagnitude_ + 1);
+        subBucketHalfCount_ = subBucketCount_ / 2;
+        subBucketMask_ = subBucketCount_ - 1;
+
+        int buckets = 1;
+        for (int64_t smallestUntrackable = subBucketCount_; smallestUntrackable <= highestTrackable; smallestUntrackable <<= 1) {
+            ++buckets;
+        }
+        counts_.assign(static_cast<size_t>((buckets + 1) * subBucketHalfCount_), 0);
+    }
+
+    // Values above highestTrackable are counted as highestTrackable
+    void record(int64_t value, int64_t count = 1) {
+        value = std::min(std::max<int64_t>(value, 0), highestTrackable_);
+        counts_[indexOf(value)] += count;
+        total_ += count;
+        max_ = std::max(max_, value);
+        min_ = std::min(min_, value);
+        sum_ += static_cast<double>(value) * count;
+    }
+
+    // Records value and, as HdrHistogram's recordCorrectedValue does, the
+    // samples a stalled closed-loop client would have missed every
+    // expectedInterval. Open-loop callers measure from the intended send
+    // time instead and don't need this.
+    void recordCorrected(int64_t value, int64_t expectedInterval) {
+        record(value);
+        if (expectedInterval <= 0) {
+            return;
+        }
+        for (int64_t missing = value - expectedInterval; missing >= expectedInterval; missing -= expectedInterval) {
+            record(missing);
+        }
+    }
+
+    void merge(const HdrHistogram& other) {
+        for (size_t i = 0; i < counts_.size() && i < other.counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+        min_ = std::min(min_, other.min_);
+    }
+
+    void reset() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+        sum_ = 0;
+        max_ = 0;
+        min_ = INT64_MAX;
+    }
+
+    // Highest value equivalent to the one at percentile (0-100)
+    int64_t valueAtPercentile(double percentile) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        int64_t target = std::max<int64_t>(1, static_cast<int64_t>(percentile / 100.0 * total_ + 0.5));
+        int64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= target) {
+                return std::min(highestEquivalent(valueAt(i)), max_);
+            }
+        }
+        return max_;
+    }
+
+    int64_t count() const { return total_; }
+    int64_t max() const { return max_; }
+    int64_t min() const { return total_ ? min_ : 0; }
+    double mean() const { return total_ ? sum_ / total_ : 0; }
+
+private:
+    int bucketOf(int64_t value) const {
+        int pow2Ceiling = 64 - __builtin_clzll(static_cast<uint64_t>(value | subBucketMask_));
+        return pow2Ceiling - (subBucketHalfCountMagnitude_ + 1);
+    }
+
+    size_t indexOf(int64_t value) const {
+        int bucket = bucketOf(value);
+        int64_t subBucket = value >> bucket;
+        return static_cast<size_t>(((int64_t(bucket) + 1) << subBucketHalfCountMagnitude_) + (subBucket - subBucketHalfCount_));
+    }
+
+    int64_t valueAt(size_t index) const {
+        int bucket = static_cast<int>(index >> subBucketHalfCountMagnitude_) - 1;
+        int64_t subBucket = static_cast<int64_t>(index & (subBucketHalfCount_ - 1)) + subBucketHalfCount_;
+        if (bucket < 0) {
+            subBucket -= subBucketHalfCount_;
+            bucket = 0;
+        }
+        return subBucket << bucket;
+    }
+
+    int64_t highestEquivalent(int64_t value) const {
+        int bucket = bucketOf(value);
+        int64_t subBucket = value >> bucket;
+        if (subBucket >= subBucketCount_) {
+            ++bucket;
+        }
+        int64_t rangeSize = int64_t(1) << bucket;
+        int64_t lowest = (value >> bucket) << bucket;
+        return lowest + rangeSize - 1;
+    }
+
+private:
+    int64_t highestTrackable_;
+    int subBucketHalfCountMagnitude_;
+    int64_t subBucketCount_;
+    int64_t subBucketHalfCount_;
+    int64_t subBucketMask_;
+    std::vector<int64_t> counts_;
+    int64_t total_ = 0;
+    double sum_ = 0;
+    int64_t max_ = 0;
+    int64_t min_ = INT64_MAX;
+};
+
+#endif
@@ -0,0 +1,285 @@
+// Open-loop load generator for the server.
+//
+// Each of --clients threads owns a DEALER socket and sends on a fixed
+// schedule (or Poisson arrivals with --poisson) so the total offered rate is
+// --rate requests per second, whether or not replies keep up. Latency is
+// measured from the time a request was due to be sent, not when it was
+// actually sent, so a stalled server can't hide its stalls by slowing the
+// client down (coordinated omission). The uncorrected numbers, from the
+// actual send, are printed alongside for comparison.
+//
+//   loadgen --endpoint tcp://127.0.0.1:5555 --clients 16 --rate 2000
+//           --duration 30 --warmup 5 --runs 3 --mix point=80,scan=15,write=5
+//
+// Query kinds, against the person table main.cpp creates:
+//   point  SELECT * FROM person WHERE id = <random id>
+//   scan   SELECT * FROM person LIMIT 100 OFFSET <random offset>
+//   write  UPDATE person SET name = '...' WHERE id = <random id>
+
+#include "HdrHistogram.h"
+#include "cppzmq/zmq.hpp"
+#include <msgpack.hpp>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+    string endpoint = "tcp://127.0.0.1:5555";
+    int clients = 16;
+    double rate = 1000;        // requests per second, all clients together
+    double duration = 30;      // seconds measured per run
+    double warmup = 5;         // seconds sent but not measured, before each run
+    double drain = 5;          // seconds to wait for outstanding replies
+    int runs = 1;
+    int rows = 500000;         // ids and offsets are drawn from 1..rows
+    bool poisson = false;
+    vector<pair<string, int>> mix = {{"point", 80}, {"scan", 15}, {"write", 5}};
+};
+
+struct ClientResult {
+    HdrHistogram corrected;   // from the intended send time
+    HdrHistogram uncorrected; // from the actual send time
+    uint64_t sent = 0;
+    uint64_t ok = 0;
+    uint64_t errors = 0;
+    uint64_t busy = 0;
+    uint64_t timeouts = 0;
+};
+
+void usage() {
+    cerr << "usage: loadgen [--endpoint E] [--clients N] [--rate R] [--duration S] [--warmup S]\n"
+            "               [--drain S] [--runs N] [--rows N] [--mix point=80,scan=15,write=5] [--poisson]" << endl;
+    exit(EXIT_FAILURE);
+}
+
+vector<pair<string, int>> parseMix(const string &text) {
+    vector<pair<string, int>> mix;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        size_t equals = item.find('=');
+        string kind = item.substr(0, equals);
+        if (equals == string::npos || (kind != "point" && kind != "scan" && kind != "write")) {
+            cerr << "Bad mix entry '" << item << "'" << endl;
+            usage();
+        }
+        mix.emplace_back(kind, atoi(item.c_str() + equals + 1));
+    }
+    return mix;
+}
+
+Options parseOptions(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--poisson") {
+            options.poisson = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+        }
+        string value = argv[++i];
+        if (arg == "--endpoint") options.endpoint = value;
+        else if (arg == "--clients") options.clients = atoi(value.c_str());
+        else if (arg == "--rate") options.rate = atof(value.c_str());
+        else if (arg == "--duration") options.duration = atof(value.c_str());
+        else if (arg == "--warmup") options.warmup = atof(value.c_str());
+        else if (arg == "--drain") options.drain = atof(value.c_str());
+        else if (arg == "--runs") options.runs = atoi(value.c_str());
+        else if (arg == "--rows") options.rows = atoi(value.c_str());
+        else if (arg == "--mix") options.mix = parseMix(value);
+        else usage();
+    }
+    if (options.clients < 1 || options.rate <= 0 || options.duration <= 0 || options.rows < 1) {
+        usage();
+    }
+    return options;
+}
+
+string makeQuery(const string &kind, int rows, mt19937_64 &random) {
+    uniform_int_distribution<int> row(1, rows);
+    if (kind == "scan") {
+        return "SELECT * FROM person LIMIT 100 OFFSET " + to_string(row(random) - 1);
+    }
+    if (kind == "write") {
+        return "UPDATE person SET name = 'loadgen-" + to_string(random() % 1000000) + "' WHERE id = " + to_string(row(random));
+    }
+    return "SELECT * FROM person WHERE id = " + to_string(row(random));
+}
+
+void runClient(zmq::context_t &context, const Options &options, int index, Clock::time_point start,
+               Clock::time_point measureFrom, Clock::time_point end, ClientResult &result) {
+    zmq::socket_t socket(context, zmq::socket_type::dealer);
+    socket.set(zmq::sockopt::routing_id, "loadgen-" + to_string(getpid()) + "-" + to_string(index));
+    socket.set(zmq::sockopt::linger, 0);
+    socket.connect(options.endpoint);
+
+    mt19937_64 random(random_device{}() + index);
+    vector<int> weights;
+    for (const auto &entry : options.mix) {
+        weights.push_back(entry.second);
+    }
+    discrete_distribution<size_t> pickKind(weights.begin(), weights.end());
+    double meanInterval = options.clients / options.rate; // seconds between this client's sends
+    exponential_distribution<double> poissonGap(1.0 / meanInterval);
+    auto gap = [&]() {
+        double seconds = options.poisson ? poissonGap(random) : meanInterval;
+        return chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+    };
+
+    // Spread the clients' first sends over one interval
+    Clock::time_point next = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(meanInterval * index / options.clients));
+    struct Pending {
+        Clock::time_point intended;
+        Clock::time_point sent;
+    };
+    unordered_map<string, Pending> pending;
+    uint64_t sequence = 0;
+    Clock::time_point drainUntil = end + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.drain));
+
+    auto receiveReplies = [&]() {
+        zmq::message_t reply;
+        while (socket.recv(reply, zmq::recv_flags::dontwait)) {
+            Clock::time_point now = Clock::now();
+            try {
+                msgpack::object_handle handle = msgpack::unpack(static_cast<const char *>(reply.data()), reply.size());
+                map<string, msgpack::object> fields;
+                handle.get().convert(fields);
+                auto found = pending.find(fields.count("id") ? fields["id"].as<string>() : "");
+                if (found == pending.end()) {
+                    continue;
+                }
+                bool error = false;
+                bool busy = false;
+                for (const auto &field : fields) {
+                    error = error || field.first.compare(0, 6, "ERROR:") == 0;
+                    busy = busy || field.first == "ERROR:BUSY";
+                }
+                if (found->second.intended >= measureFrom) {
+                    result.corrected.record(chrono::duration_cast<chrono::microseconds>(now - found->second.intended).count());
+                    result.uncorrected.record(chrono::duration_cast<chrono::microseconds>(now - found->second.sent).count());
+                    if (busy) {
+                        ++result.busy;
+                    } else if (error) {
+                        ++result.errors;
+                    } else {
+                        ++result.ok;
+                    }
+                }
+                pending.erase(found);
+            } catch (const msgpack::unpack_error &) {
+            } catch (const msgpack::type_error &) {
+            }
+        }
+    };
+
+    while (true) {
+        Clock::time_point now = Clock::now();
+        if (now < end && now >= next) {
+            // Send everything that is due, even if we are behind schedule
+            string id = to_string(index) + "-" + to_string(sequence++);
+            msgpack::sbuffer payload;
+            msgpack::packer<msgpack::sbuffer> packer(payload);
+            packer.pack_map(2);
+            packer.pack("id");
+            packer.pack(id);
+            packer.pack("query");
+            packer.pack(makeQuery(options.mix[pickKind(random)].first, options.rows, random));
+            socket.send(zmq::message_t(), zmq::send_flags::sndmore);
+            socket.send(zmq::buffer(payload.data(), payload.size()), zmq::send_flags::none);
+            pending[id] = Pending{next, Clock::now()};
+            if (next >= measureFrom) {
+                ++result.sent;
+            }
+            next += gap();
+            continue;
+        }
+        if (now >= end && (pending.empty() || now >= drainUntil)) {
+            break;
+        }
+
+        // Wait for replies until the next send is due; poll has millisecond
+        // resolution, so the last millisecond is spun
+        Clock::time_point wakeAt = now < end ? min(next, end) : drainUntil;
+        auto wait = chrono::duration_cast<chrono::milliseconds>(wakeAt - now) - chrono::milliseconds(1);
+        if (wait > chrono::milliseconds(0)) {
+            zmq::pollitem_t items[] = {{socket.handle(), 0, ZMQ_POLLIN, 0}};
+            zmq::poll(items, 1, wait);
+        }
+        receiveReplies();
+    }
+
+    // Unanswered requests took at least until now
+    Clock::time_point now = Clock::now();
+    for (const auto &entry : pending) {
+        if (entry.second.intended >= measureFrom) {
+            result.corrected.record(chrono::duration_cast<chrono::microseconds>(now - entry.second.intended).count());
+            ++result.timeouts;
+        }
+    }
+}
+
+void printPercentiles(const string &label, const HdrHistogram &histogram) {
+    cout << "  " << left << setw(34) << label << right
+         << " p50 " << setw(8) << histogram.valueAtPercentile(50)
+         << " p90 " << setw(8) << histogram.valueAtPercentile(90)
+         << " p99 " << setw(8) << histogram.valueAtPercentile(99)
+         << " p99.9 " << setw(8) << histogram.valueAtPercentile(99.9)
+         << " max " << setw(8) << histogram.max() << endl;
+}
+
+int main(int argc, char *argv[]) {
+    Options options = parseOptions(argc, argv);
+    zmq::context_t context(1);
+
+    cout << "loadgen: " << options.clients << " clients, " << options.rate << " req/s"
+         << (options.poisson ? " (Poisson)" : "") << ", " << options.duration << " s runs after "
+         << options.warmup << " s warmup, against " << options.endpoint << endl;
+
+    for (int run = 1; run <= options.runs; ++run) {
+        auto start = Clock::now() + chrono::milliseconds(100);
+        auto measureFrom = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.warmup));
+        auto end = measureFrom + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.duration));
+
+        vector<ClientResult> results(options.clients);
+        vector<thread> clients;
+        for (int i = 0; i < options.clients; ++i) {
+            clients.emplace_back(runClient, ref(context), cref(options), i, start, measureFrom, end, ref(results[i]));
+        }
+        for (thread &client : clients) {
+            client.join();
+        }
+
+        ClientResult total;
+        for (const ClientResult &result : results) {
+            total.corrected.merge(result.corrected);
+            total.uncorrected.merge(result.uncorrected);
+            total.sent += result.sent;
+            total.ok += result.ok;
+            total.errors += result.errors;
+            total.busy += result.busy;
+            total.timeouts += result.timeouts;
+        }
+        cout << fixed << setprecision(1)
+             << "run " << run << ": sent " << total.sent << " (" << total.sent / options.duration << "/s), ok "
+             << total.ok << " (" << total.ok / options.duration << "/s), errors " << total.errors
+             << ", busy " << total.busy << ", timeouts " << total.timeouts << endl;
+        printPercentiles("latency us (from intended send)", total.corrected);
+        printPercentiles("latency us (from actual send)", total.uncorrected);
+    }
+    return 0;
+}
@@ -0,0 +1,366 @@
+// Microbenchmarks for the serialization and parsing hot paths of the server,
+// built on Google Benchmark. Results go to JSON so a change to
+// handleRequest can be compared against the run before it:
+//
+//   microbench --benchmark_out=before.json --benchmark_out_format=json
+//   ... change, rebuild ...
+//   microbench --benchmark_out=after.json --benchmark_out_format=json
+//
+// (compare the two with Google Benchmark's tools/compare.py, or read the
+// "real_time" fields). 'make microbench' does the first step into
+// dist/bench/microbench.json.
+//
+// Cases:
+//   Unpack/*          msgpack::unpack + convert to map<string, msgpack::object>,
+//                     as the receive loop in main() does
+//   EncodeRowMaps/*   the current reply: {"id", "data": [{column: value}, ...]}
+//   EncodeRowArrays/* column names once, then one array of strings per row
+//   EncodeColumnar/*  one array of values per column
+//   EncodeTyped/*     row arrays with numbers packed as numbers
+//   Sbuffer*/*        sbuffer growth: fresh, reserved up front, and reused
+//
+// Row cases take (rows, columns). Columns cycle through int, string, double
+// and datetime values, with 24-byte strings like the synthetic backend.
+
+#include <benchmark/benchmark.h>
+#include <msgpack.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+
+enum class ColumnType { Int, String, Double, Datetime };
+
+ColumnType columnType(size_t column) {
+    static const ColumnType cycle[] = {ColumnType::Int, ColumnType::String, ColumnType::Double, ColumnType::Datetime};
+    return cycle[column % 4];
+}
+
+string columnName(size_t column) {
+    static const char *names[] = {"id", "name", "score", "created_at"};
+    return string(names[column % 4]) + (column < 4 ? "" : "_" + to_string(column / 4));
+}
+
+string cellValue(size_t row, size_t column) {
+    char text[32];
+    switch (columnType(column)) {
+        case ColumnType::Int:
+            return to_string(row + 1);
+        case ColumnType::Double:
+            snprintf(text, sizeof(text), "%.4f", (row + 1) * 1.25 + column);
+            return text;
+        case ColumnType::Datetime:
+            snprintf(text, sizeof(text), "2024-01-%02zu %02zu:%02zu:%02zu", row % 28 + 1, row % 24, row % 60, column % 60);
+            return text;
+        case ColumnType::String:
+        default: {
+            string value(24, 'a');
+            for (size_t i = 0; i < value.size(); ++i) {
+                value[i] = static_cast<char>('a' + (row * 7 + column * 3 + i) % 26);
+            }
+            return value;
+        }
+    }
+}
+
+// Rows as handleRequest builds them from a result set
+vector<map<string, string>> makeRows(size_t rows, size_t columns) {
+    vector<map<string, string>> results;
+    results.reserve(rows);
+    for (size_t r = 0; r < rows; ++r) {
+        map<string, string> row;
+        for (size_t c = 0; c < columns; ++c) {
+            row[columnName(c)] = cellValue(r, c);
+        }
+        results.push_back(row);
+    }
+    return results;
+}
+
+// The same rows in column order, for the array-based encodings
+struct Table {
+    vector<string> names;
+    vector<vector<string>> rows;
+};
+
+Table makeTable(size_t rows, size_t columns) {
+    Table table;
+    for (size_t c = 0; c < columns; ++c) {
+        table.names.push_back(columnName(c));
+    }
+    table.rows.resize(rows);
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < columns; ++c) {
+            table.rows[r].push_back(cellValue(r, c));
+        }
+    }
+    return table;
+}
+
+void rowArgs(benchmark::internal::Benchmark *b) {
+    for (int rows : {1, 10, 100, 10000}) {
+        for (int columns : {4, 16}) {
+            b->Args({rows, columns});
+        }
+    }
+}
+
+void setCounters(benchmark::State &state, size_t bytes) {
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.counters["reply_bytes"] = static_cast<double>(bytes);
+    state.counters["rows_per_second"] = benchmark::Counter(static_cast<double>(state.iterations() * state.range(0)),
+                                                           benchmark::Counter::kIsRate);
+}
+
+// Requests as clients send them: raw SQL, a named query with parameters,
+// and a traced request with a deadline
+string requestPayload(int kind) {
+    msgpack::sbuffer sbuf;
+    msgpack::packer<msgpack::sbuffer> packer(sbuf);
+    if (kind == 0) {
+        packer.pack_map(2);
+        packer.pack("id");
+        packer.pack("q-000123");
+        packer.pack("query");
+        packer.pack("SELECT * FROM person WHERE id = 4711");
+    } else if (kind == 1) {
+        packer.pack_map(3);
+        packer.pack("id");
+        packer.pack("q-000123");
+        packer.pack("name");
+        packer.pack("person_by_email");
+        packer.pack("params");
+        packer.pack_array(2);
+        packer.pack("someone@example.com");
+        packer.pack(42);
+    } else {
+        packer.pack_map(6);
+        packer.pack("id");
+        packer.pack("q-000123");
+        packer.pack("query");
+        packer.pack("SELECT id, name, email FROM person WHERE created_at > '2024-01-01' ORDER BY id LIMIT 100");
+        packer.pack("priority");
+        packer.pack(1);
+        packer.pack("deadline_ms");
+        packer.pack(250);
+        packer.pack("trace");
+        packer.pack(true);
+        packer.pack("trace_id");
+        packer.pack("4bf92f3577b34da6a3ce929d0e0e4736");
+    }
+    return string(sbuf.data(), sbuf.size());
+}
+
+void Unpack(benchmark::State &state) {
+    string payload = requestPayload(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        msgpack::object_handle oh = msgpack::unpack(payload.data(), payload.size());
+        msgpack::object received = oh.get();
+        map<string, msgpack::object> receivedMap;
+        received.convert(receivedMap);
+        benchmark::DoNotOptimize(receivedMap);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * payload.size()));
+}
+BENCHMARK(Unpack)->ArgName("kind")->Arg(0)->Arg(1)->Arg(2);
+
+void EncodeRowMaps(benchmark::State &state) {
+    vector<map<string, string>> results = makeRows(state.range(0), state.range(1));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        msgpack::sbuffer sbuf;
+        msgpack::packer<msgpack::sbuffer> packer(sbuf);
+        packer.pack_map(2);
+        packer.pack("id");
+        packer.pack("q-000123");
+        packer.pack("data");
+        packer.pack(results);
+        bytes = sbuf.size();
+        benchmark::DoNotOptimize(sbuf.data());
+    }
+    setCounters(state, bytes);
+}
+BENCHMARK(EncodeRowMaps)->ArgNames({"rows", "columns"})->Apply(rowArgs);
+
+// Includes building the row maps, which handleRequest pays for as well
+void BuildAndEncodeRowMaps(benchmark::State &state) {
+    Table table = makeTable(state.range(0), state.range(1));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        vector<map<string, string>> results;
+        for (const vector<string> &values : table.rows) {
+            map<string, string> row;
+            for (size_t c = 0; c < values.size(); ++c) {
+                row[table.names[c]] = values[c];
+            }
+            results.push_back(row);
+        }
+        msgpack::sbuffer sbuf;
+        msgpack::packer<msgpack::sbuffer> packer(sbuf);
+        packer.pack_map(2);
+        packer.pack("id");
+        packer.pack("q-000123");
+        packer.pack("data");
+        packer.pack(results);
+        bytes = sbuf.size();
+        benchmark::DoNotOptimize(sbuf.data());
+    }
+    setCounters(state, bytes);
+}
+BENCHMARK(BuildAndEncodeRowMaps)->ArgNames({"rows", "columns"})->Apply(rowArgs);
+
+void EncodeRowArrays(benchmark::State &state) {
+    Table table = makeTable(state.range(0), state.range(1));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        msgpack::sbuffer sbuf;
+        msgpack::packer<msgpack::sbuffer> packer(sbuf);
+        packer.pack_map(3);
+        packer.pack("id");
+        packer.pack("q-000123");
+        packer.pack("columns");
+        packer.pack(table.names);
+        packer.pack("rows");
+        packer.pack(table.rows);
+        bytes = sbuf.size();
+        benchmark::DoNotOptimize(sbuf.data());
+    }
+    setCounters(state, bytes);
+}
+BENCHMARK(EncodeRowArrays)->ArgNames({"rows", "columns"})->Apply(rowArgs);
+
+void EncodeColumnar(benchmark::State &state) {
+    Table table = makeTable(state.range(0), state.range(1));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        msgpack::sbuffer sbuf;
+        msgpack::packer<msgpack::sbuffer> packer(sbuf);
+        packer.pack_map(2);
+        packer.pack("id");
+        packer.pack("q-000123");
+        packer.pack("columns");
+        packer.pack_map(static_cast<uint32_t>(table.names.size()));
+        for (size_t c = 0; c < table.names.size(); ++c) {
+            packer.pack(table.names[c]);
+            packer.pack_array(static_cast<uint32_t>(table.rows.size()));
+            for (const vector<string> &row : table.rows) {
+                packer.pack(row[c]);
+            }
+        }
+        bytes = sbuf.size();
+        benchmark::DoNotOptimize(sbuf.data());
+    }
+    setCounters(state, bytes);
+}
+BENCHMARK(EncodeColumnar)->ArgNames({"rows", "columns"})->Apply(rowArgs);
+
+// Numbers converted and packed natively, as a typed reply would carry them
+void EncodeTyped(benchmark::State &state) {
+    Table table = makeTable(state.range(0), state.range(1));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        msgpack::sbuffer sbuf;
+        msgpack::packer<msgpack::sbuffer> packer(sbuf);
+        packer.pack_map(3);
+        packer.pack("id");
+        packer.pack("q-000123");
+        packer.pack("columns");
+        packer.pack(table.names);
+        packer.pack("rows");
+        packer.pack_array(static_cast<uint32_t>(table.rows.size()));
+        for (const vector<string> &row : table.rows) {
+            packer.pack_array(static_cast<uint32_t>(row.size()));
+            for (size_t c = 0; c < row.size(); ++c) {
+                switch (columnType(c)) {
+                    case ColumnType::Int:
+                        packer.pack(strtoll(row[c].c_str(), nullptr, 10));
+                        break;
+                    case ColumnType::Double:
+                        packer.pack(strtod(row[c].c_str(), nullptr));
+                        break;
+                    default:
+                        packer.pack(row[c]);
+                }
+            }
+        }
+        bytes = sbuf.size();
+        benchmark::DoNotOptimize(sbuf.data());
+    }
+    setCounters(state, bytes);
+}
+BENCHMARK(EncodeTyped)->ArgNames({"rows", "columns"})->Apply(rowArgs);
+
+// Packs bytes of 64-byte strings into the buffer
+template <typename Buffer>
+void fill(Buffer &sbuf, size_t bytes) {
+    static const string chunk(61, 'x'); // 3-byte str8 header + 61 bytes
+    msgpack::packer<Buffer> packer(sbuf);
+    for (size_t written = 0; written < bytes; written += 64) {
+        packer.pack(chunk);
+    }
+}
+
+void bufferArgs(benchmark::internal::Benchmark *b) {
+    b->ArgName("bytes");
+    for (int bytes : {1 << 10, 64 << 10, 1 << 20, 8 << 20}) {
+        b->Arg(bytes);
+    }
+}
+
+// A new sbuffer per reply, growing from the default 8 KiB by doubling
+void SbufferFresh(benchmark::State &state) {
+    size_t bytes = state.range(0);
+    for (auto _ : state) {
+        msgpack::sbuffer sbuf;
+        fill(sbuf, bytes);
+        benchmark::DoNotOptimize(sbuf.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+BENCHMARK(SbufferFresh)->Apply(bufferArgs);
+
+// A new sbuffer sized for the reply up front
+void SbufferReserved(benchmark::State &state) {
+    size_t bytes = state.range(0);
+    for (auto _ : state) {
+        msgpack::sbuffer sbuf(bytes + 64);
+        fill(sbuf, bytes);
+        benchmark::DoNotOptimize(sbuf.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+BENCHMARK(SbufferReserved)->Apply(bufferArgs);
+
+// One sbuffer cleared and refilled, keeping its capacity between replies
+void SbufferReused(benchmark::State &state) {
+    size_t bytes = state.range(0);
+    msgpack::sbuffer sbuf;
+    for (auto _ : state) {
+        sbuf.clear();
+        fill(sbuf, bytes);
+        benchmark::DoNotOptimize(sbuf.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+BENCHMARK(SbufferReused)->Apply(bufferArgs);
+
+// Chunks referenced rather than copied into one growing block
+void VrefbufferFresh(benchmark::State &state) {
+    size_t bytes = state.range(0);
+    for (auto _ : state) {
+        msgpack::vrefbuffer vbuf;
+        fill(vbuf, bytes);
+        benchmark::DoNotOptimize(vbuf.vector());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+BENCHMARK(VrefbufferFresh)->Apply(bufferArgs);
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,322 @@
+// Connection pool stress test with fault injection.
+//
+// Starts a FaultProxy in front of a local MySQL/MariaDB, points a
+// MySQLConnectionPool at the proxy and has --threads workers check out a
+// connection, run --query and release it, as fast as they can (or with
+// --hold-us between checkouts). A fault schedule changes how the proxy
+// behaves while the test runs:
+//
+//   poolstress --upstream 127.0.0.1:3306 --user root --password secret
+//              --pool 10 --budget 16 --threads 32 --duration 60
+//              --faults 10:latency=50,20:pass,25:reset,35:flaky=5,45:blackhole,50:pass
+//
+// Each schedule entry is <seconds from start>:<fault>, with faults pass,
+// latency=MS, flaky=PERCENT, reset, down and blackhole (see FaultProxy.h).
+// Every --interval seconds, and per fault phase at the end, it prints
+// checkout (acquire) and query latency percentiles in microseconds, error
+// counts, and connections the pool opened and closed (churn).
+
+#include "HdrHistogram.h"
+#include "FaultProxy.h"
+#include "mySQLConnectionPool.h"
+#include <cppconn/statement.h>
+#include <cppconn/resultset.h>
+#include <cppconn/exception.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+namespace {
+
+struct Fault {
+    double at = 0; // seconds from start
+    string name;
+    FaultProxy::Mode mode = FaultProxy::Mode::Pass;
+    int value = 0;
+};
+
+struct Options {
+    string upstreamHost = "127.0.0.1";
+    uint16_t upstreamPort = 3306;
+    uint16_t listenPort = 0;
+    string user = "root";
+    string password;
+    string database = "testdb";
+    string query = "SELECT 1";
+    int pool = 10;
+    int budget = 16;          // connections checked out at once
+    int threads = 32;
+    int heartbeat = 1;        // seconds between pool health checks
+    int holdUs = 0;           // pause between checkouts, per worker
+    double duration = 60;
+    double interval = 1;      // seconds between progress lines
+    vector<Fault> faults;
+};
+
+// What the workers measured since the last report, or over a phase
+struct Sample {
+    HdrHistogram acquire;
+    HdrHistogram query;
+    uint64_t ok = 0;
+    uint64_t acquireErrors = 0;
+    uint64_t queryErrors = 0;
+
+    void merge(const Sample &other) {
+        acquire.merge(other.acquire);
+        query.merge(other.query);
+        ok += other.ok;
+        acquireErrors += other.acquireErrors;
+        queryErrors += other.queryErrors;
+    }
+
+    void reset() {
+        acquire.reset();
+        query.reset();
+        ok = acquireErrors = queryErrors = 0;
+    }
+};
+
+struct Worker {
+    mutex lock;
+    Sample sample;
+};
+
+void usage() {
+    cerr << "usage: poolstress [--upstream HOST:PORT] [--listen PORT] [--user U] [--password P] [--database D]\n"
+            "                  [--query SQL] [--pool N] [--budget N] [--threads N] [--heartbeat S] [--hold-us US]\n"
+            "                  [--duration S] [--interval S] [--faults AT:FAULT,...]" << endl;
+    exit(EXIT_FAILURE);
+}
+
+Fault parseFault(const string &item) {
+    Fault fault;
+    size_t colon = item.find(':');
+    if (colon == string::npos) {
+        cerr << "Bad fault '" << item << "'" << endl;
+        usage();
+    }
+    fault.at = atof(item.c_str());
+    fault.name = item.substr(colon + 1);
+    size_t equals = fault.name.find('=');
+    string kind = fault.name.substr(0, equals);
+    fault.value = equals == string::npos ? 0 : atoi(fault.name.c_str() + equals + 1);
+    if (kind == "pass") fault.mode = FaultProxy::Mode::Pass;
+    else if (kind == "latency") fault.mode = FaultProxy::Mode::Latency;
+    else if (kind == "flaky") fault.mode = FaultProxy::Mode::Flaky;
+    else if (kind == "reset") fault.mode = FaultProxy::Mode::Reset;
+    else if (kind == "down") fault.mode = FaultProxy::Mode::Down;
+    else if (kind == "blackhole") fault.mode = FaultProxy::Mode::Blackhole;
+    else {
+        cerr << "Unknown fault '" << kind << "'" << endl;
+        usage();
+    }
+    return fault;
+}
+
+Options parseOptions(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+        }
+        string value = argv[++i];
+        if (arg == "--upstream") {
+            size_t colon = value.rfind(':');
+            options.upstreamHost = value.substr(0, colon);
+            if (colon != string::npos) {
+                options.upstreamPort = static_cast<uint16_t>(atoi(value.c_str() + colon + 1));
+            }
+        } else if (arg == "--listen") options.listenPort = static_cast<uint16_t>(atoi(value.c_str()));
+        else if (arg == "--user") options.user = value;
+        else if (arg == "--password") options.password = value;
+        else if (arg == "--database") options.database = value;
+        else if (arg == "--query") options.query = value;
+        else if (arg == "--pool") options.pool = atoi(value.c_str());
+        else if (arg == "--budget") options.budget = atoi(value.c_str());
+        else if (arg == "--threads") options.threads = atoi(value.c_str());
+        else if (arg == "--heartbeat") options.heartbeat = atoi(value.c_str());
+        else if (arg == "--hold-us") options.holdUs = atoi(value.c_str());
+        else if (arg == "--duration") options.duration = atof(value.c_str());
+        else if (arg == "--interval") options.interval = atof(value.c_str());
+        else if (arg == "--faults") {
+            stringstream in(value);
+            string item;
+            while (getline(in, item, ',')) {
+                options.faults.push_back(parseFault(item));
+            }
+        } else usage();
+    }
+    if (options.pool < 1 || options.budget < 1 || options.threads < 1 || options.heartbeat < 1 ||
+        options.duration <= 0 || options.interval <= 0) {
+        usage();
+    }
+    return options;
+}
+
+int64_t microsSince(Clock::time_point start) {
+    return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count();
+}
+
+void runWorker(MySQLConnectionPool &pool, const Options &options, const atomic<bool> &stop, Worker &worker) {
+    while (!stop) {
+        Clock::time_point start = Clock::now();
+        sql::Connection *conn = nullptr;
+        try {
+            conn = pool.getConnection(0);
+        } catch (const std::exception &) {
+            {
+                lock_guard<mutex> lock(worker.lock);
+                ++worker.sample.acquireErrors;
+                worker.sample.acquire.record(microsSince(start));
+            }
+            // The pool gives up its budget slot on failure; don't spin on a dead server
+            this_thread::sleep_for(chrono::milliseconds(10));
+            continue;
+        }
+        int64_t acquireUs = microsSince(start);
+
+        Clock::time_point queryStart = Clock::now();
+        bool failed = false;
+        try {
+            unique_ptr<sql::Statement> stmt(conn->createStatement());
+            unique_ptr<sql::ResultSet> res(stmt->executeQuery(options.query));
+            while (res->next()) {
+            }
+        } catch (const sql::SQLException &) {
+            failed = true;
+        }
+        int64_t queryUs = microsSince(queryStart);
+        pool.releaseConnection(conn, 0);
+        {
+            lock_guard<mutex> lock(worker.lock);
+            worker.sample.acquire.record(acquireUs);
+            worker.sample.query.record(queryUs);
+            if (failed) {
+                ++worker.sample.queryErrors;
+            } else {
+                ++worker.sample.ok;
+            }
+        }
+        if (options.holdUs > 0) {
+            this_thread::sleep_for(chrono::microseconds(options.holdUs));
+        }
+    }
+}
+
+void printLine(const string &label, double seconds, const Sample &sample, uint64_t opened, uint64_t closed) {
+    cout << fixed << setprecision(1) << left << setw(18) << label << right
+         << " ok/s " << setw(8) << sample.ok / seconds
+         << "  acquire p50 " << setw(7) << sample.acquire.valueAtPercentile(50)
+         << " p99 " << setw(8) << sample.acquire.valueAtPercentile(99)
+         << " max " << setw(8) << sample.acquire.max()
+         << "  query p50 " << setw(7) << sample.query.valueAtPercentile(50)
+         << " p99 " << setw(8) << sample.query.valueAtPercentile(99)
+         << "  errors acquire " << sample.acquireErrors << " query " << sample.queryErrors
+         << "  opened " << opened << " closed " << closed << endl;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    Options options = parseOptions(argc, argv);
+    FaultProxy proxy(options.upstreamHost, options.upstreamPort, options.listenPort);
+    cout << "poolstress: proxy 127.0.0.1:" << proxy.port() << " -> " << options.upstreamHost << ":" << options.upstreamPort
+         << ", pool " << options.pool << ", budget " << options.budget << ", " << options.threads << " threads, "
+         << options.duration << " s" << endl;
+
+    MySQLConnectionPool pool("127.0.0.1:" + to_string(proxy.port()), options.user, options.password, options.database,
+                             options.pool, options.heartbeat, {}, {options.budget}, 0, chrono::microseconds(0));
+
+    atomic<bool> stop(false);
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    for (int i = 0; i < options.threads; ++i) {
+        workers.emplace_back(new Worker());
+        threads.emplace_back(runWorker, ref(pool), cref(options), cref(stop), ref(*workers.back()));
+    }
+
+    // Phases in schedule order; the first runs fault-free until the first entry
+    vector<Fault> schedule = options.faults;
+    if (schedule.empty() || schedule.front().at > 0) {
+        Fault initial;
+        initial.name = "pass";
+        schedule.insert(schedule.begin(), initial);
+    }
+    struct Phase {
+        string name;
+        double seconds = 0;
+        Sample sample;
+        uint64_t opened = 0;
+        uint64_t closed = 0;
+    };
+    vector<Phase> phases;
+
+    Clock::time_point start = Clock::now();
+    size_t nextFault = 0;
+    uint64_t lastOpened = pool.connectionsOpened();
+    uint64_t lastClosed = pool.connectionsClosed();
+    Sample interval;
+    for (double elapsed = 0; elapsed < options.duration;) {
+        while (nextFault < schedule.size() && schedule[nextFault].at <= elapsed) {
+            const Fault &fault = schedule[nextFault++];
+            proxy.setFault(fault.mode, fault.value);
+            phases.emplace_back();
+            phases.back().name = fault.name;
+            cout << "t=" << fixed << setprecision(1) << elapsed << " s: " << fault.name << endl;
+        }
+        double until = min(elapsed + options.interval, options.duration);
+        if (nextFault < schedule.size()) {
+            until = min(until, schedule[nextFault].at);
+        }
+        this_thread::sleep_until(start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(until)));
+        double seconds = until - elapsed;
+        elapsed = until;
+
+        interval.reset();
+        for (auto &worker : workers) {
+            lock_guard<mutex> lock(worker->lock);
+            interval.merge(worker->sample);
+            worker->sample.reset();
+        }
+        uint64_t opened = pool.connectionsOpened();
+        uint64_t closed = pool.connectionsClosed();
+        Phase &phase = phases.back();
+        phase.seconds += seconds;
+        phase.sample.merge(interval);
+        phase.opened += opened - lastOpened;
+        phase.closed += closed - lastClosed;
+        ostringstream label;
+        label << "t=" << fixed << setprecision(1) << elapsed;
+        printLine(label.str(), seconds, interval, opened - lastOpened, closed - lastClosed);
+        lastOpened = opened;
+        lastClosed = closed;
+    }
+
+    // Unblock workers stuck on a held connection before joining them
+    stop = true;
+    proxy.setFault(FaultProxy::Mode::Down);
+    for (thread &worker : threads) {
+        worker.join();
+    }
+
+    cout << "\nper phase (latency in us):" << endl;
+    for (const Phase &phase : phases) {
+        if (phase.seconds > 0) {
+            printLine(phase.name, phase.seconds, phase.sample, phase.opened, phase.closed);
+        }
+    }
+    cout << "proxy: " << proxy.accepted() << " connections accepted, " << proxy.resets() << " reset" << endl;
+    return 0;
+}
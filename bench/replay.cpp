@@ -0,0 +1,349 @@
+// Replays a request capture (CAPTURE_FILE, see RequestCapture.h) against a
+// server and reports latency distributions.
+//
+//   replay --file capture.jsonl --endpoint tcp://127.0.0.1:5555 --speed 1
+//
+// --speed 1 sends each message at its captured offset from the first one,
+// --speed N N times faster and --speed max as fast as possible. Every
+// captured client gets its own DEALER socket and its messages are sent in
+// captured order, so per-client ordering is preserved; clients are spread
+// over --threads sender threads. Latency is measured from each message's
+// scheduled send time (see bench/loadgen.cpp) and reported overall and per
+// named query, with raw SQL under "sql".
+
+#include "HdrHistogram.h"
+#include "cppzmq/zmq.hpp"
+#include "nlohmann/json.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+    string file;
+    string endpoint = "tcp://127.0.0.1:5555";
+    double speed = 1;   // 0 for as fast as possible
+    int threads = 4;
+    double drain = 10;  // seconds to wait for outstanding replies
+};
+
+// One captured message, scheduled relative to the start of the replay
+struct Event {
+    Clock::duration offset;
+    size_t client;      // index into the thread's clients
+    string payload;     // MessagePack
+    string id;
+    size_t label;       // index into labels
+    bool expectsReply;
+};
+
+struct Stats {
+    HdrHistogram corrected;   // from the scheduled send time
+    HdrHistogram uncorrected; // from the actual send time
+    uint64_t sent = 0;
+    uint64_t ok = 0;
+    uint64_t errors = 0;
+    uint64_t timeouts = 0;
+
+    void merge(const Stats &other) {
+        corrected.merge(other.corrected);
+        uncorrected.merge(other.uncorrected);
+        sent += other.sent;
+        ok += other.ok;
+        errors += other.errors;
+        timeouts += other.timeouts;
+    }
+};
+
+struct Shard {
+    vector<Event> events;
+    vector<string> clients;   // captured identity (hex), for the socket identity
+    vector<Stats> byLabel;
+};
+
+void usage() {
+    cerr << "usage: replay --file capture.jsonl [--endpoint E] [--speed 1|N|max] [--threads N] [--drain S]" << endl;
+    exit(EXIT_FAILURE);
+}
+
+Options parseOptions(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        string value = argv[i + 1];
+        if (arg == "--file") options.file = value;
+        else if (arg == "--endpoint") options.endpoint = value;
+        else if (arg == "--speed") options.speed = value == "max" ? 0 : atof(value.c_str());
+        else if (arg == "--threads") options.threads = atoi(value.c_str());
+        else if (arg == "--drain") options.drain = atof(value.c_str());
+        else usage();
+    }
+    if (argc % 2 == 0 || options.file.empty() || options.speed < 0 || options.threads < 1) {
+        usage();
+    }
+    return options;
+}
+
+void runShard(zmq::context_t &context, const Options &options, Shard &shard, Clock::time_point start) {
+    struct Client {
+        unique_ptr<zmq::socket_t> socket;
+        size_t remaining = 0; // events not sent yet
+        struct Pending {
+            Clock::time_point scheduled;
+            Clock::time_point sent;
+            size_t label;
+        };
+        unordered_map<string, deque<Pending>> pending;
+        size_t pendingCount = 0;
+    };
+    vector<Client> clients(shard.clients.size());
+    for (const Event &event : shard.events) {
+        ++clients[event.client].remaining;
+    }
+    vector<size_t> open;                  // clients with a socket
+    vector<zmq::pollitem_t> pollItems;
+    bool pollItemsStale = true;
+
+    auto receive = [&](size_t index) {
+        Client &client = clients[index];
+        zmq::message_t reply;
+        while (client.socket && client.socket->recv(reply, zmq::recv_flags::dontwait)) {
+            Clock::time_point now = Clock::now();
+            nlohmann::json fields;
+            try {
+                fields = nlohmann::json::from_msgpack(static_cast<const uint8_t *>(reply.data()),
+                                                      static_cast<const uint8_t *>(reply.data()) + reply.size());
+            } catch (const nlohmann::json::exception &) {
+                continue;
+            }
+            if (!fields.is_object() || !fields.contains("id") || !fields["id"].is_string()) {
+                continue;
+            }
+            auto found = client.pending.find(fields["id"].get<string>());
+            if (found == client.pending.end() || found->second.empty()) {
+                continue;
+            }
+            Client::Pending sent = found->second.front();
+            found->second.pop_front();
+            --client.pendingCount;
+            bool error = false;
+            for (auto field = fields.begin(); field != fields.end(); ++field) {
+                error = error || field.key().compare(0, 6, "ERROR:") == 0;
+            }
+            Stats &stats = shard.byLabel[sent.label];
+            stats.corrected.record(chrono::duration_cast<chrono::microseconds>(now - sent.scheduled).count());
+            stats.uncorrected.record(chrono::duration_cast<chrono::microseconds>(now - sent.sent).count());
+            ++(error ? stats.errors : stats.ok);
+        }
+        // Done with this client
+        if (client.socket && client.remaining == 0 && client.pendingCount == 0) {
+            client.socket.reset();
+            pollItemsStale = true;
+        }
+    };
+    auto receiveAll = [&]() {
+        for (size_t index : open) {
+            receive(index);
+        }
+        if (pollItemsStale) {
+            vector<size_t> stillOpen;
+            for (size_t index : open) {
+                if (clients[index].socket) {
+                    stillOpen.push_back(index);
+                }
+            }
+            open.swap(stillOpen);
+        }
+    };
+
+    size_t next = 0;
+    Clock::time_point sendsEnd = Clock::time_point::max();
+    while (true) {
+        Clock::time_point now = Clock::now();
+        if (next < shard.events.size()) {
+            const Event &event = shard.events[next];
+            Clock::time_point scheduled = start + event.offset;
+            if (now >= scheduled) {
+                Client &client = clients[event.client];
+                if (!client.socket) {
+                    client.socket.reset(new zmq::socket_t(context, zmq::socket_type::dealer));
+                    client.socket->set(zmq::sockopt::routing_id, "replay-" + to_string(getpid()) + "-" + shard.clients[event.client]);
+                    client.socket->set(zmq::sockopt::linger, 1000); // let the last sends go out after close
+                    client.socket->connect(options.endpoint);
+                    open.push_back(event.client);
+                    pollItemsStale = true;
+                }
+                client.socket->send(zmq::message_t(), zmq::send_flags::sndmore);
+                client.socket->send(zmq::buffer(event.payload), zmq::send_flags::none);
+                ++shard.byLabel[event.label].sent;
+                --client.remaining;
+                if (event.expectsReply) {
+                    client.pending[event.id].push_back({scheduled, Clock::now(), event.label});
+                    ++client.pendingCount;
+                }
+                if (++next % 64 == 0) {
+                    receiveAll();
+                }
+                continue;
+            }
+        } else if (sendsEnd == Clock::time_point::max()) {
+            sendsEnd = now;
+        }
+        Clock::time_point drainUntil = sendsEnd == Clock::time_point::max() ? sendsEnd :
+            sendsEnd + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.drain));
+        if (next == shard.events.size() && (open.empty() || now >= drainUntil)) {
+            break;
+        }
+
+        // Wait for replies until the next send is due
+        Clock::time_point wakeAt = next < shard.events.size() ? start + shard.events[next].offset : drainUntil;
+        auto wait = chrono::duration_cast<chrono::milliseconds>(wakeAt - now) - chrono::milliseconds(1);
+        if (wait > chrono::milliseconds(0) && !open.empty()) {
+            if (pollItemsStale) {
+                pollItems.clear();
+                for (size_t index : open) {
+                    pollItems.push_back({clients[index].socket->handle(), 0, ZMQ_POLLIN, 0});
+                }
+                pollItemsStale = false;
+            }
+            zmq::poll(pollItems.data(), pollItems.size(), min(wait, chrono::milliseconds(100)));
+        }
+        receiveAll();
+    }
+
+    for (Client &client : clients) {
+        for (const auto &entry : client.pending) {
+            for (const Client::Pending &lost : entry.second) {
+                Stats &stats = shard.byLabel[lost.label];
+                stats.corrected.record(chrono::duration_cast<chrono::microseconds>(Clock::now() - lost.scheduled).count());
+                ++stats.timeouts;
+            }
+        }
+    }
+}
+
+void printRow(const string &label, const Stats &stats) {
+    cout << left << setw(32) << label.substr(0, 31) << right
+         << setw(9) << stats.sent << setw(9) << stats.ok << setw(7) << stats.errors << setw(7) << stats.timeouts
+         << setw(10) << stats.corrected.valueAtPercentile(50) << setw(10) << stats.corrected.valueAtPercentile(99)
+         << setw(10) << stats.corrected.valueAtPercentile(99.9) << setw(10) << stats.corrected.max()
+         << setw(12) << stats.uncorrected.valueAtPercentile(99) << endl;
+}
+
+int main(int argc, char *argv[]) {
+    Options options = parseOptions(argc, argv);
+    ifstream in(options.file);
+    if (!in.is_open()) {
+        cerr << "Cannot open " << options.file << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Load the capture, sharding clients over the sender threads
+    vector<Shard> shards(options.threads);
+    vector<string> labels;
+    map<string, size_t> labelIndex;
+    unordered_map<string, pair<size_t, size_t>> clientIndex; // identity -> (shard, client)
+    int64_t firstUs = -1;
+    int64_t lastUs = 0;
+    size_t lineNumber = 0;
+    size_t skipped = 0;
+    string line;
+    while (getline(in, line)) {
+        ++lineNumber;
+        nlohmann::json record;
+        try {
+            record = nlohmann::json::parse(line);
+        } catch (const nlohmann::json::exception &) {
+            ++skipped;
+            continue;
+        }
+        if (!record.contains("ts_us") || !record.contains("client") || !record.contains("request") || !record["request"].is_object()) {
+            ++skipped;
+            continue;
+        }
+        const nlohmann::json &request = record["request"];
+        int64_t ts = record["ts_us"].get<int64_t>();
+        firstUs = firstUs < 0 ? ts : firstUs;
+        lastUs = max(lastUs, ts);
+
+        string label = request.contains("name") ? request["name"].get<string>() :
+                       request.contains("command") ? "command:" + request["command"].get<string>() : "sql";
+        if (!labelIndex.count(label)) {
+            labelIndex[label] = labels.size();
+            labels.push_back(label);
+        }
+        string identity = record["client"].get<string>();
+        auto found = clientIndex.find(identity);
+        if (found == clientIndex.end()) {
+            size_t shard = hash<string>()(identity) % shards.size();
+            found = clientIndex.emplace(identity, make_pair(shard, shards[shard].clients.size())).first;
+            shards[shard].clients.push_back(identity);
+        }
+
+        Event event;
+        double offsetUs = options.speed > 0 ? (ts - firstUs) / options.speed : 0;
+        event.offset = chrono::duration_cast<Clock::duration>(chrono::duration<double, micro>(offsetUs));
+        event.client = found->second.second;
+        vector<uint8_t> bytes = nlohmann::json::to_msgpack(request);
+        event.payload.assign(bytes.begin(), bytes.end());
+        event.id = request.contains("id") && request["id"].is_string() ? request["id"].get<string>() : "";
+        event.label = labelIndex[label];
+        // Fire-and-forget writes and cancels get no reply of their own
+        event.expectsReply = !event.id.empty() && request.value("ack", "") != "none" && request.value("command", "") != "cancel";
+        shards[found->second.first].events.push_back(move(event));
+    }
+    for (Shard &shard : shards) {
+        shard.byLabel.resize(labels.size());
+    }
+    double capturedSeconds = (lastUs - max<int64_t>(firstUs, 0)) / 1e6;
+    cout << "replay: " << lineNumber - skipped << " messages from " << clientIndex.size() << " clients spanning "
+         << fixed << setprecision(1) << capturedSeconds << " s, speed "
+         << (options.speed > 0 ? to_string(options.speed) + "x" : string("max")) << ", against " << options.endpoint << endl;
+    if (skipped) {
+        cout << "skipped " << skipped << " unreadable lines" << endl;
+    }
+
+    zmq::context_t context(1);
+    auto start = Clock::now() + chrono::milliseconds(100);
+    vector<thread> threads;
+    for (Shard &shard : shards) {
+        threads.emplace_back(runShard, ref(context), cref(options), ref(shard), start);
+    }
+    for (thread &sender : threads) {
+        sender.join();
+    }
+    double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<Stats> byLabel(labels.size());
+    Stats total;
+    for (const Shard &shard : shards) {
+        for (size_t i = 0; i < labels.size(); ++i) {
+            byLabel[i].merge(shard.byLabel[i]);
+            total.merge(shard.byLabel[i]);
+        }
+    }
+    cout << "replayed in " << elapsed << " s (" << total.sent / max(elapsed, 1e-9) << " msg/s)" << endl
+         << "latency in us, from the scheduled send time; last column from the actual send" << endl;
+    cout << left << setw(32) << "query" << right << setw(9) << "sent" << setw(9) << "ok" << setw(7) << "errors"
+         << setw(7) << "lost" << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max"
+         << setw(12) << "p99 (send)" << endl;
+    for (size_t i = 0; i < labels.size(); ++i) {
+        printRow(labels[i], byLabel[i]);
+    }
+    printRow("all", total);
+    return 0;
+}
@@ -7,8 +7,33 @@
 #include <future>
 #include <mutex>
 #include <condition_variable>
+#include <cstdlib>
+#include <exception>
 #include "cppzmq/zmq.hpp"
 #include "mySQLConnectionPool.h"
+#include "WriteBehindBuffer.h"
+#include "SqlStatement.h"
+#include "QueryRegistry.h"
+#include "LookupCoalescer.h"
+#include "TableCache.h"
+#include "Request.h"
+#include "RequestScheduler.h"
+#include "QueryWatchdog.h"
+#include "ConcurrencyLimiter.h"
+#include "BulkheadClassifier.h"
+#include "WorkerPool.h"
+#include "AdminServer.h"
+#include "AppConfig.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include "FingerprintStats.h"
+#include "Logger.h"
+#include "SpanExporter.h"
+#include "RequestCapture.h"
+#include "MySqlBackend.h"
+#include "SyntheticBackend.h"
+#include "WorkerMemory.h"
+#include "ChunkedReply.h"
 #include <cppconn/statement.h>
 #include <cppconn/resultset.h>
 #include <cppconn/prepared_statement.h> // Required for PreparedStatement
@@ -16,74 +41,733 @@
 
 using namespace std;
 
+// Settings from .env and the environment. Loaded before the other globals,
+// which are built from it; invalid settings stop the server before it
+// connects to anything.
+PaulNovack::AppConfig loadConfig() {
+    PaulNovack::AppConfig config(".env");
+    vector<string> errors = config.validate();
+    if (!errors.empty()) {
+        for (const string &error : errors) {
+            cerr << "Invalid configuration: " << error << endl;
+        }
+        exit(EXIT_FAILURE);
+    }
+    config.printSummary(cout);
+    // Created here, before the other globals, so it outlives them
+    LogLevel level = LogLevel::Info;
+    Logger::parseLevel(config.LOG_LEVEL, level);
+    Logger::instance().configure(level, config.LOG_RATE_PER_SECOND);
+    return config;
+}
+
+PaulNovack::AppConfig config = loadConfig();
+
 // Globals
 mutex mtx;
-condition_variable cv;
 int responses = 0;
-const int maxThreads = 80;
 
-// Queue to hold pending requests
-queue<tuple<string, string, string>> requestQueue;
+// Prometheus metrics, served on METRICS_ENDPOINT. Gauges are registered in main().
+metrics::Registry metricsRegistry;
+const string stageMetric = "asyncsql_stage_duration_seconds";
+const string stageHelp = "Time spent in each stage of handling a request";
+// One queue_wait histogram per priority class, so waits of low-priority
+// requests don't hide those of urgent ones
+vector<metrics::Histogram *> queueWaitTimes = [] {
+    vector<metrics::Histogram *> histograms;
+    for (int priority = 0; priority < config.QUEUE_PRIORITY_CLASSES; ++priority) {
+        histograms.push_back(&metricsRegistry.histogram(stageMetric, stageHelp,
+            "stage=\"queue_wait\",priority=\"" + to_string(priority) + "\""));
+    }
+    return histograms;
+}();
+metrics::Histogram &poolAcquireTime = metricsRegistry.histogram(stageMetric, stageHelp, "stage=\"pool_acquire\"");
+metrics::Histogram &executeTime = metricsRegistry.histogram(stageMetric, stageHelp, "stage=\"execute\"");
+metrics::Histogram &fetchTime = metricsRegistry.histogram(stageMetric, stageHelp, "stage=\"fetch\"");
+metrics::Histogram &encodeTime = metricsRegistry.histogram(stageMetric, stageHelp, "stage=\"encode\"");
+metrics::Histogram &sendTime = metricsRegistry.histogram(stageMetric, stageHelp, "stage=\"send\"");
+metrics::Counter &requestsHandled = metricsRegistry.counter("asyncsql_requests_total", "Requests taken off the queue by workers");
+metrics::Counter &queryErrors = metricsRegistry.counter("asyncsql_query_errors_total", "Queries answered with an error");
+metrics::Counter &bytesSent = metricsRegistry.counter("asyncsql_sent_bytes_total", "Reply payload bytes sent to clients");
+atomic<int> busyWorkers(0);
+
+// ROUTER identities are binary; hex them for logs
+string hexId(const string &id) {
+    static const char digits[] = "0123456789abcdef";
+    string hex;
+    hex.reserve(id.size() * 2);
+    for (unsigned char c : id) {
+        hex += digits[c >> 4];
+        hex += digits[c & 0xf];
+    }
+    return hex;
+}
+
+uint64_t microsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// Multi-level request queue: strict priority between classes, deficit round
+// robin between clients and earliest deadline first per client, with aging.
+// Overload protection: requests beyond the queue capacity are refused, and
+// CoDel sheds queued requests once queue wait stays above the target.
+//
+// Bulkheads: analytic requests get their own queue, workers and connection
+// budget so slow reports can't starve point queries. OLTP keeps
+// DB_POOL_SIZE - DB_ANALYTIC_CONNECTIONS connections whatever the analytic load.
+// The server's own background work (write-behind flushes, table cache loads)
+// has a connection budget of its own but no queue or workers; clients can't
+// pick it as a class.
+const int oltpBulkhead = 0;
+const int analyticBulkhead = 1;
+const int internalBulkhead = 2;
 
-// Initialize MySQL connection pool
-const int poolSize = 80;
-const int heartbeatInterval = 60;
+RequestScheduler requestScheduler(config.QUEUE_PRIORITY_CLASSES, chrono::milliseconds(config.QUEUE_AGING_THRESHOLD_MS),
+                                  config.QUEUE_FAIR_QUANTUM, config.QUEUE_MAX_OUTSTANDING_PER_CLIENT, config.QUEUE_CAPACITY,
+                                  chrono::milliseconds(config.QUEUE_CODEL_TARGET_MS), chrono::milliseconds(config.QUEUE_CODEL_INTERVAL_MS));
+RequestScheduler analyticScheduler(config.QUEUE_PRIORITY_CLASSES, chrono::milliseconds(config.QUEUE_AGING_THRESHOLD_MS),
+                                   config.QUEUE_FAIR_QUANTUM, config.QUEUE_MAX_OUTSTANDING_PER_CLIENT, config.ANALYTIC_QUEUE_CAPACITY,
+                                   chrono::milliseconds(config.ANALYTIC_CODEL_TARGET_MS), chrono::milliseconds(config.ANALYTIC_CODEL_INTERVAL_MS));
 
+RequestScheduler &schedulerFor(int bulkhead) {
+    return bulkhead == analyticBulkhead ? analyticScheduler : requestScheduler;
+}
+
+// Worker threads per bulkhead, started in main()
+vector<unique_ptr<WorkerPool>> workerPools;
+
+// Named queries, prepared on every pooled connection
+QueryRegistry queryRegistry(config.QUERY_REGISTRY_FILE);
+
+BulkheadClassifier bulkheadClassifier({"oltp", "analytic"}, queryRegistry.bulkheadRules(), analyticBulkhead, config.ANALYTIC_LATENCY_MS);
+
+// BACKEND=synthetic: queries are answered with generated rows, nothing
+// connects to MySQL
+const bool syntheticBackend = config.BACKEND == "synthetic";
+
+// Initialize MySQL connection pool; left empty with the synthetic backend
 MySQLConnectionPool connectionPool(
-    "mysql:3306", // MySQL host
-    "root",                 // MySQL user
-    "password",             // MySQL password
-    "testdb",               // MySQL database
-    poolSize,               // Pool size
-    heartbeatInterval       // Heartbeat interval
+    config.DB_HOST,
+    config.DB_USERNAME,
+    config.DB_PASSWORD,
+    config.DB_DATABASE_NAME,
+    syntheticBackend ? 0 : config.DB_POOL_SIZE,
+    config.DB_HEARTBEAT_INTERVAL,
+    queryRegistry.statements(), // Named queries to prepare
+    {config.DB_POOL_SIZE, config.DB_ANALYTIC_CONNECTIONS, config.DB_INTERNAL_CONNECTIONS}, // Connection budget per bulkhead
+    syntheticBackend ? 0 : config.DB_STARTUP_DELAY_SECONDS,
+    chrono::microseconds(config.DB_CHECKOUT_DELAY_US)
 );
 
-// Function to handle a single request
-void handleRequest(zmq::socket_t &socket, const string &queryId, const string &query, const string &clientId) {
-    sql::Connection* conn = nullptr;
+// In-memory copies of the tables listed under "cached_tables" in queries.json
+TableCache tableCache(connectionPool, internalBulkhead, syntheticBackend ? vector<CachedTableConfig>() : queryRegistry.cachedTables());
+
+// Kills queries that run past their deadline or are cancelled by the client
+QueryWatchdog queryWatchdog(connectionPool, chrono::milliseconds(config.WATCHDOG_INTERVAL_MS));
+
+// How many requests run against MySQL at once, adapted to query RTT. Workers
+// over the limit leave their requests in the scheduler queue.
+ConcurrencyLimiter concurrencyLimiter(config.CONCURRENCY_INITIAL, config.CONCURRENCY_MIN, config.CONCURRENCY_MAX);
+
+// Calls, latency, rows and errors per statement fingerprint, for the
+// top_queries admin command
+FingerprintStats queryStats(config.FINGERPRINT_STATS_MAX);
+
+// Per-request spans written to SPAN_FILE for latency investigations
+SpanExporter spanExporter(config.SPAN_FILE, static_cast<uint64_t>(config.SPAN_FILE_MAX_MB) << 20, config.SPAN_FILE_KEEP,
+                          config.SPAN_SAMPLE_PERCENT, config.SPAN_SLOW_MS);
+
+// Copies of incoming messages in CAPTURE_FILE, for replay with bench/replay
+RequestCapture requestCapture(config.CAPTURE_FILE, static_cast<uint64_t>(config.CAPTURE_MAX_MB) << 20);
+
+// Write-behind buffer for writes sent with an "ack" mode
+WriteBehindBuffer writeBehind(connectionPool, internalBulkhead, config.WRITE_BEHIND_FLUSH_INTERVAL_MS, config.WRITE_BEHIND_MAX_ROWS);
+
+// Merges concurrent lookups of named queries that have a "coalesce" entry
+LookupCoalescer lookupCoalescer(connectionPool, queryWatchdog, queryRegistry);
+
+unique_ptr<QueryBackend> makeBackend() {
+    if (!syntheticBackend) {
+        return unique_ptr<QueryBackend>(new MySqlBackend(connectionPool));
+    }
+    vector<SyntheticBackend::Column> columns;
     try {
-        // Get a connection from the pool
-        conn = connectionPool.getConnection();
+        columns = SyntheticBackend::parseColumns(config.SYNTHETIC_COLUMNS);
+    } catch (const invalid_argument &e) {
+        cerr << "Invalid SYNTHETIC_COLUMNS: " << e.what() << endl;
+        exit(1);
+    }
+    cout << "Synthetic backend: " << config.SYNTHETIC_ROWS << " rows of " << columns.size() << " columns" << endl;
+    return unique_ptr<QueryBackend>(new SyntheticBackend(columns, config.SYNTHETIC_ROWS, config.SYNTHETIC_VALUE_BYTES,
+                                                         chrono::microseconds(config.SYNTHETIC_LATENCY_US)));
+}
 
-        // Execute the query
-        unique_ptr<sql::Statement> stmt(conn->createStatement());
-        unique_ptr<sql::ResultSet> res(stmt->executeQuery(query));
-
-        // Convert result set to MessagePack-compatible data
-        vector<map<string, string>> results;
-        while (res->next()) {
-            map<string, string> row;
-            for (unsigned int i = 1; i <= res->getMetaData()->getColumnCount(); ++i) {
-                string columnName = res->getMetaData()->getColumnLabel(i);
-                string columnValue = res->getString(i);
-                row[columnName] = columnValue;
+// Where handleRequest runs queries
+unique_ptr<QueryBackend> queryBackend = makeBackend();
+
+// Send a serialized response back to a client
+void sendResponse(zmq::socket_t &socket, const string &clientId, const msgpack::sbuffer &sbuf) {
+    lock_guard<mutex> lock(mtx);
+    socket.send(zmq::buffer(clientId), zmq::send_flags::sndmore);
+    socket.send(zmq::buffer(sbuf.data(), sbuf.size()), zmq::send_flags::none);
+    bytesSent.add(sbuf.size());
+}
+
+// Send {"id": queryId, key: value}
+void sendStatus(zmq::socket_t &socket, const string &clientId, const string &queryId, const string &key, const string &value) {
+    msgpack::sbuffer sbuf;
+    msgpack::packer<msgpack::sbuffer> packer(sbuf);
+    packer.pack_map(2);
+    packer.pack("id");
+    packer.pack(queryId);
+    packer.pack(key);
+    packer.pack(value);
+    sendResponse(socket, clientId, sbuf);
+}
+
+// Send {"id": queryId, "ERROR:BUSY": reason, "retry_after_ms": n}
+void sendBusy(zmq::socket_t &socket, const string &clientId, const string &queryId, const string &reason, int retryAfterMs) {
+    msgpack::sbuffer sbuf;
+    msgpack::packer<msgpack::sbuffer> packer(sbuf);
+    packer.pack_map(3);
+    packer.pack("id");
+    packer.pack(queryId);
+    packer.pack("ERROR:BUSY");
+    packer.pack(reason);
+    packer.pack("retry_after_ms");
+    packer.pack(retryAfterMs);
+    sendResponse(socket, clientId, sbuf);
+}
+
+// Hand a write to the write-behind buffer. "queued" is acknowledged right
+// away, "committed" once its group commit succeeds and "none" never.
+// Returns false if the query isn't a write and must be run normally.
+bool handleBufferedWrite(zmq::socket_t &socket, const Request &request) {
+    WriteBehindBuffer::Completion done;
+    bool committed = request.ackMode == "committed";
+    string table = statementTable(request.query);
+    if (committed || tableCache.contains(table)) {
+        string queryId = request.queryId;
+        string clientId = request.clientId;
+        done = [&socket, queryId, clientId, table, committed](const string &error) {
+            tableCache.invalidate(table);
+            if (!committed) {
+                return;
             }
-            results.push_back(row);
+            if (error.empty()) {
+                sendStatus(socket, clientId, queryId, "ack", "committed");
+            } else {
+                sendStatus(socket, clientId, queryId, "ERROR:SQLException", error);
+            }
+        };
+    }
+    if (!writeBehind.enqueue(request.query, done)) {
+        return false;
+    }
+    if (request.ackMode == "queued") {
+        sendStatus(socket, request.clientId, request.queryId, "ack", "queued");
+    }
+    return true;
+}
+
+// Answer a named query backed by the table cache without touching MySQL
+void sendCachedLookup(zmq::socket_t &socket, const Request &request, const NamedQuery &named) {
+    TableCache::Rows rows;
+    bool found;
+    if (named.cacheRange) {
+        if (request.params.size() != 2) {
+            sendStatus(socket, request.clientId, request.queryId, "ERROR:ASYNCSQLSERVERGENERALEXCEPTION", "Range lookups take two params: low and high.");
+            return;
+        }
+        found = tableCache.range(named.cacheTable, paramText(request.params[0]), paramText(request.params[1]), rows);
+    } else {
+        if (request.params.size() != 1) {
+            sendStatus(socket, request.clientId, request.queryId, "ERROR:ASYNCSQLSERVERGENERALEXCEPTION", "Cached lookups take one param.");
+            return;
         }
+        found = tableCache.lookup(named.cacheTable, named.cacheColumn, paramText(request.params[0]), rows);
+    }
+    if (!found) {
+        sendStatus(socket, request.clientId, request.queryId, "ERROR:ASYNCSQLSERVERTABLENOTCACHED", named.cacheTable);
+        return;
+    }
+
+    msgpack::sbuffer sbuf;
+    msgpack::packer<msgpack::sbuffer> packer(sbuf);
+    packer.pack_map(2);
+    packer.pack("id");
+    packer.pack(request.queryId);
+    packer.pack("data");
+    packer.pack(rows);
+    sendResponse(socket, request.clientId, sbuf);
+}
+
+// Queue, worker and connection figures of one bulkhead
+void packBulkheadStats(msgpack::packer<msgpack::sbuffer> &packer, int bulkhead) {
+    RequestScheduler &scheduler = schedulerFor(bulkhead);
+    vector<RequestScheduler::ClassStats> queue = scheduler.stats();
+
+    packer.pack_map(5);
+    packer.pack("workers");
+    packer.pack(workerPools[bulkhead]->size());
+    packer.pack("connections");
+    packer.pack(connectionPool.connectionsInUse(bulkhead));
+    packer.pack("connection_budget");
+    packer.pack(connectionPool.bulkheadBudget(bulkhead));
+    packer.pack("rejected");
+    packer.pack(scheduler.rejected());
+    packer.pack("queue");
+    packer.pack_array(queue.size());
+    for (const RequestScheduler::ClassStats &priorityClass : queue) {
+        packer.pack_map(7);
+        packer.pack("depth");
+        packer.pack(priorityClass.depth);
+        packer.pack("clients");
+        packer.pack(priorityClass.clients);
+        packer.pack("dequeued");
+        packer.pack(priorityClass.dequeued);
+        packer.pack("aged");
+        packer.pack(priorityClass.aged);
+        packer.pack("shed");
+        packer.pack(priorityClass.shed);
+        packer.pack("avg_wait_ms");
+        packer.pack(priorityClass.avgWaitMs);
+        packer.pack("max_wait_ms");
+        packer.pack(priorityClass.maxWaitMs);
+    }
+}
+
+// Reply to a {"command": "stats"} request with server metrics
+void sendStats(zmq::socket_t &socket, const Request &request) {
+    WriteBehindBuffer::Stats wb = writeBehind.stats();
+    LookupCoalescer::Stats lc = lookupCoalescer.stats();
+    vector<TableCache::TableStats> tc = tableCache.stats();
+    ConcurrencyLimiter::Stats cl = concurrencyLimiter.stats();
+
+    msgpack::sbuffer sbuf;
+    msgpack::packer<msgpack::sbuffer> packer(sbuf);
+    packer.pack_map(2);
+    packer.pack("id");
+    packer.pack(request.queryId);
+    packer.pack("stats");
+    packer.pack_map(8);
+    packer.pack("killed_queries");
+    packer.pack(queryWatchdog.kills());
+    packer.pack("internal_connections");
+    packer.pack(connectionPool.connectionsInUse(internalBulkhead));
+    packer.pack("bulkheads");
+    packer.pack_map(bulkheadClassifier.size());
+    for (int bulkhead = 0; bulkhead < static_cast<int>(bulkheadClassifier.size()); ++bulkhead) {
+        packer.pack(bulkheadClassifier.name(bulkhead));
+        packBulkheadStats(packer, bulkhead);
+    }
+    packer.pack("concurrency");
+    packer.pack_map(5);
+    packer.pack("limit");
+    packer.pack(cl.limit);
+    packer.pack("inflight");
+    packer.pack(cl.inflight);
+    packer.pack("rtt_noload_ms");
+    packer.pack(cl.rttNoLoadMs);
+    packer.pack("rtt_ms");
+    packer.pack(cl.rttMs);
+    packer.pack("samples");
+    packer.pack(cl.samples);
+    packer.pack("write_behind");
+    packer.pack_map(10);
+    packer.pack("pending_writes");
+    packer.pack(wb.pendingWrites);
+    packer.pack("pending_rows");
+    packer.pack(wb.pendingRows);
+    packer.pack("flushes");
+    packer.pack(wb.flushes);
+    packer.pack("failed_flushes");
+    packer.pack(wb.failedFlushes);
+    packer.pack("flushed_writes");
+    packer.pack(wb.flushedWrites);
+    packer.pack("flushed_rows");
+    packer.pack(wb.flushedRows);
+    packer.pack("flushed_statements");
+    packer.pack(wb.flushedStatements);
+    packer.pack("last_flush_ms");
+    packer.pack(wb.lastFlushMs);
+    packer.pack("max_flush_ms");
+    packer.pack(wb.maxFlushMs);
+    packer.pack("avg_flush_ms");
+    packer.pack(wb.avgFlushMs);
+    packer.pack("coalescer");
+    packer.pack_map(3);
+    packer.pack("lookups");
+    packer.pack(lc.lookups);
+    packer.pack("batches");
+    packer.pack(lc.batches);
+    packer.pack("avg_batch_size");
+    packer.pack(lc.avgBatchSize);
+    packer.pack("table_cache");
+    packer.pack_map(tc.size());
+    for (const TableCache::TableStats &table : tc) {
+        packer.pack(table.table);
+        packer.pack_map(4);
+        packer.pack("rows");
+        packer.pack(table.rows);
+        packer.pack("loads");
+        packer.pack(table.loads);
+        packer.pack("hits");
+        packer.pack(table.hits);
+        packer.pack("last_load_ms");
+        packer.pack(table.lastLoadMs);
+    }
+    sendResponse(socket, request.clientId, sbuf);
+}
+
+// One stage of handling a request; zero until the request reaches it
+struct StageTime {
+    chrono::steady_clock::time_point start;
+    chrono::steady_clock::time_point end;
+
+    bool reached() const { return start != chrono::steady_clock::time_point(); }
+    uint64_t micros() const {
+        return end > start ? chrono::duration_cast<chrono::microseconds>(end - start).count() : 0;
+    }
+};
+
+// Timeline of a request after it leaves the queue, for the latency
+// histograms, the "timing" reply map and exported spans
+struct RequestTiming {
+    StageTime acquire; // waiting for a pooled connection
+    StageTime execute;
+    StageTime fetch;   // reading rows (or write counters) back from MySQL
+    StageTime encode;
+    StageTime send;
+};
+
+// sendWaitUs: time spent waiting to hand the reply to the socket
+template <typename Buffer>
+void packTiming(msgpack::packer<Buffer> &packer, const Request &request, const RequestTiming &timing, uint64_t sendWaitUs) {
+    packer.pack("timing");
+    packer.pack_map(6);
+    packer.pack("queue_us");
+    packer.pack(static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(request.dequeued - request.received).count()));
+    packer.pack("acquire_us");
+    packer.pack(timing.acquire.micros());
+    packer.pack("execute_us");
+    packer.pack(timing.execute.micros());
+    packer.pack("fetch_us");
+    packer.pack(timing.fetch.micros());
+    packer.pack("encode_us");
+    packer.pack(timing.encode.micros());
+    packer.pack("send_us");
+    packer.pack(sendWaitUs);
+}
+
+// Hands the request's spans to the span exporter, which keeps them if the
+// trace was sampled, failed or was slow. A stage cut short by an error ends now.
+void exportSpans(const Request &request, const RequestTiming &timing, uint64_t rows, const string &error) {
+    if (!spanExporter.enabled()) {
+        return;
+    }
+    auto now = chrono::steady_clock::now();
+    TraceRecord trace;
+    trace.traceId = request.traceId.empty() ? SpanExporter::newTraceId() : request.traceId;
+    trace.parentSpanId = request.parentSpanId;
+    trace.sampled = request.sampled;
+    trace.error = error;
+    trace.attributes = {{"query_id", request.queryId}, {"client_id", hexId(request.clientId)},
+                        {"fingerprint", request.fingerprint}, {"bulkhead", bulkheadClassifier.name(request.bulkhead)},
+                        {"rows", to_string(rows)}};
+    string rootId = SpanExporter::newSpanId();
+    trace.spans.push_back({"request", rootId, request.parentSpanId, request.arrived, now});
+    trace.spans.push_back({"receive", SpanExporter::newSpanId(), rootId, request.arrived, request.received});
+    trace.spans.push_back({"queue", SpanExporter::newSpanId(), rootId, request.received, request.dequeued});
+    const pair<const char *, const StageTime *> stages[] = {
+        {"pool_acquire", &timing.acquire}, {"execute", &timing.execute}, {"fetch", &timing.fetch},
+        {"encode", &timing.encode}, {"send", &timing.send}};
+    for (const auto &stage : stages) {
+        if (stage.second->reached()) {
+            auto end = stage.second->end > stage.second->start ? stage.second->end : now;
+            trace.spans.push_back({stage.first, SpanExporter::newSpanId(), rootId, stage.second->start, end});
+        }
+    }
+    spanExporter.submit(move(trace));
+}
+
+// extraFields: entries the caller packs after these four, e.g. "timing"
+void packUpdateResult(msgpack::packer<msgpack::sbuffer> &packer, const string &queryId, const UpdateCounts &counts, uint32_t extraFields = 0) {
+    packer.pack_map(4 + extraFields);
+    packer.pack("id");
+    packer.pack(queryId);
+    packer.pack("affected_rows");
+    packer.pack(counts.affectedRows);
+    packer.pack("last_insert_id");
+    packer.pack(counts.lastInsertId);
+    packer.pack("warnings");
+    packer.pack(counts.warnings);
+}
+
+// Same encoding msgpack uses for vector<map<string, string>>, without the
+// std::string copies
+template <typename Buffer>
+void packRows(msgpack::packer<Buffer> &packer, const ResultRows &rows) {
+    packer.pack_array(static_cast<uint32_t>(rows.size()));
+    for (const auto &row : rows) {
+        packer.pack_map(static_cast<uint32_t>(row.size()));
+        for (const auto &column : row) {
+            packer.pack_str(static_cast<uint32_t>(column.first.size()));
+            packer.pack_str_body(column.first.data(), static_cast<uint32_t>(column.first.size()));
+            packer.pack_str(static_cast<uint32_t>(column.second.size()));
+            packer.pack_str_body(column.second.data(), static_cast<uint32_t>(column.second.size()));
+        }
+    }
+}
+
+// Lower bound on the encoded size of rows, to choose between the reply
+// buffer and a ChunkedReply before encoding
+size_t estimateReplyBytes(const ResultRows &rows) {
+    size_t bytes = 0;
+    for (const auto &row : rows) {
+        for (const auto &column : row) {
+            bytes += column.first.size() + column.second.size() + 2;
+        }
+    }
+    return bytes;
+}
+
+template <typename Buffer>
+void packRowsReply(msgpack::packer<Buffer> &packer, const Request &request, const ResultRows &results) {
+    packer.pack_map(request.trace ? 3 : 2); // "id", "data" and, when tracing, "timing"
+    packer.pack("id");
+    packer.pack(request.queryId); // Pack the query ID
+    packer.pack("data");
+    packRows(packer, results); // Pack the results
+}
+
+// MySQL error 3024 (ER_QUERY_TIMEOUT): the MAX_EXECUTION_TIME hint aborted
+// the query before the watchdog got to it
+bool exceededMaxExecutionTime(exception_ptr error) {
+    try {
+        rethrow_exception(error);
+    } catch (sql::SQLException &e) {
+        return e.getErrorCode() == 3024;
+    } catch (...) {
+        return false;
+    }
+}
 
-        // Serialize the response using MessagePack
+// Run a single-key named lookup through the coalescer; the reply is sent
+// when the batch it joined has run. The batch's stages count in the latency
+// histograms, fingerprint statistics and spans of every lookup in it, as
+// if each had run the query itself.
+void submitCoalescedLookup(zmq::socket_t &socket, const Request &request, const NamedQuery &named) {
+    lookupCoalescer.submit(named, request.params[0], request.bulkhead, request.deadline,
+                           [&socket, request](const LookupCoalescer::Rows &rows, const LookupCoalescer::Result &result) {
+        RequestTiming timing;
+        timing.acquire = {result.timing.acquireStart, result.timing.executeStart};
+        timing.execute = {result.timing.executeStart, result.timing.fetchStart};
+        timing.fetch = {result.timing.fetchStart, result.timing.fetchEnd};
+        if (!result.error.empty()) {
+            if (timing.execute.reached()) {
+                queryStats.record(request.fingerprintHash, request.fingerprint, microsSince(timing.execute.start), 0, 0, true);
+            }
+            exportSpans(request, timing, 0, result.error);
+            if (result.killed != QueryWatchdog::Outcome::None) {
+                sendStatus(socket, request.clientId, request.queryId,
+                           result.killed == QueryWatchdog::Outcome::Timeout ? "ERROR:TIMEOUT" : "ERROR:CANCELLED", result.error);
+                return;
+            }
+            sendStatus(socket, request.clientId, request.queryId, "ERROR:SQLException", result.error);
+            queryErrors.add();
+            return;
+        }
+        poolAcquireTime.record(timing.acquire.micros());
+        executeTime.record(timing.execute.micros());
+        fetchTime.record(timing.fetch.micros());
+
+        timing.encode.start = chrono::steady_clock::now();
         msgpack::sbuffer sbuf;
         msgpack::packer<msgpack::sbuffer> packer(sbuf);
-
-        // Pack the response as a map
-        packer.pack_map(2); // Two key-value pairs: "id" and "data"
+        packer.pack_map(request.trace ? 3 : 2);
         packer.pack("id");
-        packer.pack(queryId); // Pack the query ID
+        packer.pack(request.queryId);
         packer.pack("data");
-        packer.pack(results); // Pack the results
+        packer.pack(rows);
+        timing.encode.end = chrono::steady_clock::now();
+        encodeTime.record(timing.encode.micros());
+
+        timing.send.start = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> lock(mtx);
+            if (request.trace) {
+                packTiming(packer, request, timing, microsSince(timing.send.start));
+            }
+            socket.send(zmq::buffer(request.clientId), zmq::send_flags::sndmore);
+            socket.send(zmq::buffer(sbuf.data(), sbuf.size()), zmq::send_flags::none);
+            bytesSent.add(sbuf.size());
+        }
+        timing.send.end = chrono::steady_clock::now();
+        sendTime.record(timing.send.micros());
+        queryStats.record(request.fingerprintHash, request.fingerprint, timing.execute.micros() + timing.fetch.micros(), rows.size(), sbuf.size(), false);
+        exportSpans(request, timing, rows.size(), "");
+    });
+}
+
+// Function to handle a single request
+void handleRequest(zmq::socket_t &socket, const Request &request) {
+    const string &queryId = request.queryId;
+    const string &clientId = request.clientId;
+    unique_ptr<QuerySession> session;
+    QueryWatchdog::Outcome killed = QueryWatchdog::Outcome::None;
+    RequestTiming timing;
+    // Failed queries count in the fingerprint statistics with the time they
+    // took, and their spans are always exported
+    auto recordFailure = [&request, &timing](const string &error) {
+        if (timing.execute.reached()) {
+            queryStats.record(request.fingerprintHash, request.fingerprint, microsSince(timing.execute.start), 0, 0, true);
+        }
+        exportSpans(request, timing, 0, error);
+    };
+    try {
+        const NamedQuery *named = nullptr;
+        if (!request.queryName.empty()) {
+            named = queryRegistry.find(request.queryName);
+            if (!named) {
+                sendStatus(socket, clientId, queryId, "ERROR:ASYNCSQLSERVERUNKNOWNQUERYNAME", request.queryName);
+                return;
+            }
+            if (named->cached && !syntheticBackend) {
+                sendCachedLookup(socket, request, *named);
+                return;
+            }
+            if (named->coalesce && request.params.size() == 1 && !syntheticBackend) {
+                submitCoalescedLookup(socket, request, *named);
+                return;
+            }
+        } else if (queryRegistry.whitelistOnly()) {
+            sendStatus(socket, clientId, queryId, "ERROR:ASYNCSQLSERVERQUERYNOTALLOWED", "Only named queries may be run on this server.");
+            return;
+        }
+
+        // Get a connection from the pool (or a synthetic session)
+        timing.acquire.start = chrono::steady_clock::now();
+        session = queryBackend->open(request.bulkhead);
+        timing.acquire.end = chrono::steady_clock::now();
+        poolAcquireTime.record(timing.acquire.micros());
+
+        // Execute the query. The watchdog kills it once its deadline passes or
+        // the client cancels it.
+        bool hasDeadline = request.deadline != chrono::steady_clock::time_point();
+        uint64_t watchToken = queryWatchdog.begin(clientId, queryId, session->connectionId(),
+            hasDeadline ? request.deadline : chrono::steady_clock::time_point::max());
+        // The cancel came while the request was between the queue and here
+        if (queryWatchdog.cancelledBeforeStart(watchToken)) {
+            queryWatchdog.end(watchToken);
+            sendStatus(socket, clientId, queryId, "ERROR:CANCELLED", "Cancelled by client before it ran.");
+            return;
+        }
+        // Only OLTP work counts against the adaptive limit; analytic work is
+        // bounded by its own workers and connection budget
+        bool limited = request.bulkhead == oltpBulkhead;
+        auto started = limited ? concurrencyLimiter.begin() : chrono::steady_clock::now();
+        timing.execute.start = started;
+        bool hasRows;
+        try {
+            hasRows = session->execute(request, named);
+        } catch (...) {
+            killed = queryWatchdog.end(watchToken);
+            if (killed == QueryWatchdog::Outcome::None && exceededMaxExecutionTime(current_exception())) {
+                killed = QueryWatchdog::Outcome::Timeout;
+            }
+            if (limited) {
+                concurrencyLimiter.end(started, killed == QueryWatchdog::Outcome::Timeout);
+            }
+            if (killed == QueryWatchdog::Outcome::Timeout) {
+                bulkheadClassifier.record(request.fingerprint, chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+            }
+            throw;
+        }
+        killed = queryWatchdog.end(watchToken);
+        if (limited) {
+            concurrencyLimiter.end(started, false);
+        }
+        timing.execute.end = chrono::steady_clock::now();
+        executeTime.record(timing.execute.micros());
+        uint64_t rowCount = 0;
+        bulkheadClassifier.record(request.fingerprint, chrono::duration<double, milli>(chrono::steady_clock::now() - started).count());
+
+        // Serialize the response using MessagePack, into the worker's reused buffer
+        msgpack::sbuffer &sbuf = ReplyBuffer::forThread().take();
+        msgpack::packer<msgpack::sbuffer> packer(sbuf);
+        // Large results go into chunks instead
+        unique_ptr<ChunkedReply> chunked;
+
+        if (hasRows) {
+            // Convert result set to MessagePack-compatible data, in the request arena
+            timing.fetch.start = chrono::steady_clock::now();
+            ResultRows results(RequestArena::forThread().resource());
+            session->fetch(results);
+            timing.fetch.end = chrono::steady_clock::now();
+            fetchTime.record(timing.fetch.micros());
+            rowCount = results.size();
+
+            // Pack the response as a map
+            timing.encode.start = chrono::steady_clock::now();
+            if (config.LARGE_REPLY_BYTES > 0 && estimateReplyBytes(results) >= static_cast<size_t>(config.LARGE_REPLY_BYTES)) {
+                chunked.reset(new ChunkedReply(config.REPLY_CHUNK_BYTES));
+                packRowsReply(chunked->packer(), request, results);
+            } else {
+                packRowsReply(packer, request, results);
+            }
+            timing.encode.end = chrono::steady_clock::now();
+            encodeTime.record(timing.encode.micros());
+        } else {
+            timing.fetch.start = chrono::steady_clock::now();
+            packUpdateResult(packer, queryId, session->updateCounts(), request.trace ? 1 : 0);
+            timing.fetch.end = chrono::steady_clock::now();
+            // Cached copies of the written table are stale now
+            tableCache.invalidate(statementTable(named ? named->sql : request.query));
+        }
 
         // Send the MessagePack response
+        timing.send.start = chrono::steady_clock::now();
+        bool chunkedReply = chunked != nullptr;
+        size_t replyBytes;
         {
             lock_guard<mutex> lock(mtx);
+            // Timing is packed last so it can include the wait for the socket lock
             socket.send(zmq::buffer(clientId), zmq::send_flags::sndmore);
-            socket.send(zmq::buffer(sbuf.data(), sbuf.size()), zmq::send_flags::none);
+            if (chunkedReply) {
+                if (request.trace) {
+                    packTiming(chunked->packer(), request, timing, microsSince(timing.send.start));
+                }
+                replyBytes = chunked->size();
+                ChunkedReply::send(socket, move(chunked), request.multipart);
+            } else {
+                if (request.trace) {
+                    packTiming(packer, request, timing, microsSince(timing.send.start));
+                }
+                replyBytes = sbuf.size();
+                socket.send(zmq::buffer(sbuf.data(), sbuf.size()), zmq::send_flags::none);
+            }
+            bytesSent.add(replyBytes);
             ++responses;
             if (responses % 500 == 0) {
-                cout << "Response Number: " << responses << " for Query ID: " << queryId << endl;
+                Logger::instance().log(LogLevel::Info, "Responses sent", {{"count", to_string(responses)}, {"query_id", queryId}});
             }
         }
+        timing.send.end = chrono::steady_clock::now();
+        sendTime.record(timing.send.micros());
+        if (!chunkedReply) {
+            ReplyBuffer::forThread().done(sbuf.size());
+        }
+        queryStats.record(request.fingerprintHash, request.fingerprint, timing.execute.micros() + timing.fetch.micros(), rowCount, replyBytes, false);
+        exportSpans(request, timing, rowCount, "");
     } catch (sql::SQLException &e) {
-        cerr << "SQL Error for Query ID: " << queryId << ": " << e.what() << endl;
+        recordFailure(e.what());
+        if (killed != QueryWatchdog::Outcome::None) {
+            sendStatus(socket, clientId, queryId, killed == QueryWatchdog::Outcome::Timeout ? "ERROR:TIMEOUT" : "ERROR:CANCELLED", e.what());
+            return;
+        }
+        Logger::instance().log(LogLevel::Error, "SQL error", {{"query_id", queryId}, {"client_id", hexId(clientId)},
+                                                              {"fingerprint", request.fingerprint}, {"error", e.what()}});
 
         // Serialize the error response using MessagePack
         msgpack::sbuffer sbuf;
@@ -101,8 +785,13 @@ void handleRequest(zmq::socket_t &socket, const string &queryId, const string &q
             lock_guard<mutex> lock(mtx);
             socket.send(zmq::buffer(clientId), zmq::send_flags::sndmore);
             socket.send(zmq::buffer(sbuf.data(), sbuf.size()), zmq::send_flags::none);
+            bytesSent.add(sbuf.size());
         }
+        queryErrors.add();
     } catch (const std::exception &e) {
+        recordFailure(e.what());
+        Logger::instance().log(LogLevel::Error, "Request failed", {{"query_id", queryId}, {"client_id", hexId(clientId)},
+                                                                   {"fingerprint", request.fingerprint}, {"error", e.what()}});
 
         // Serialize the error response using MessagePack
         msgpack::sbuffer sbuf;
@@ -120,9 +809,13 @@ void handleRequest(zmq::socket_t &socket, const string &queryId, const string &q
             lock_guard<mutex> lock(mtx);
             socket.send(zmq::buffer(clientId), zmq::send_flags::sndmore);
             socket.send(zmq::buffer(sbuf.data(), sbuf.size()), zmq::send_flags::none);
+            bytesSent.add(sbuf.size());
         }
+        queryErrors.add();
     } catch (...) {
-        cerr << "Unhandled exception during request processing." << endl;
+        recordFailure("Unhandled exception during request processing.");
+        Logger::instance().log(LogLevel::Error, "Unhandled exception during request processing",
+                               {{"query_id", queryId}, {"client_id", hexId(clientId)}, {"fingerprint", request.fingerprint}});
                 // Serialize the error response using MessagePack
         msgpack::sbuffer sbuf;
         msgpack::packer<msgpack::sbuffer> packer(sbuf);
@@ -139,31 +832,120 @@ void handleRequest(zmq::socket_t &socket, const string &queryId, const string &q
             lock_guard<mutex> lock(mtx);
             socket.send(zmq::buffer(clientId), zmq::send_flags::sndmore);
             socket.send(zmq::buffer(sbuf.data(), sbuf.size()), zmq::send_flags::none);
+            bytesSent.add(sbuf.size());
         }
+        queryErrors.add();
     }
-    if (conn) {
-        connectionPool.releaseConnection(conn);
+}
+
+
+// Convert the "params" array of a named query request
+vector<QueryParam> toQueryParams(const msgpack::object &array) {
+    vector<QueryParam> params;
+    if (array.type != msgpack::type::ARRAY) {
+        throw msgpack::type_error();
     }
+    params.reserve(array.via.array.size);
+    for (uint32_t i = 0; i < array.via.array.size; ++i) {
+        const msgpack::object &value = array.via.array.ptr[i];
+        switch (value.type) {
+            case msgpack::type::NIL:
+                params.emplace_back(boost::blank());
+                break;
+            case msgpack::type::BOOLEAN:
+                params.emplace_back(value.via.boolean);
+                break;
+            case msgpack::type::POSITIVE_INTEGER:
+                params.emplace_back(value.via.u64);
+                break;
+            case msgpack::type::NEGATIVE_INTEGER:
+                params.emplace_back(value.via.i64);
+                break;
+            case msgpack::type::FLOAT32:
+            case msgpack::type::FLOAT64:
+                params.emplace_back(value.via.f64);
+                break;
+            default:
+                params.emplace_back(value.as<string>());
+                break;
+        }
+    }
+    return params;
 }
 
+// {"command": "cancel", "id": ...}: drop the request if it's still queued,
+// otherwise kill it if it's running, or have the watchdog stop it from
+// running if a worker has just taken it off the queue. The cancelled request is answered with
+// ERROR:CANCELLED; the cancel message itself gets no reply.
+void cancelRequest(zmq::socket_t &socket, const string &clientId, const string &queryId) {
+    Request removed;
+    if (requestScheduler.cancel(clientId, queryId, removed) || analyticScheduler.cancel(clientId, queryId, removed)) {
+        sendStatus(socket, clientId, queryId, "ERROR:CANCELLED", "Cancelled by client before it ran.");
+    } else {
+        queryWatchdog.cancel(clientId, queryId);
+    }
+}
 
-// Worker thread function to process queued requests
-void processQueue(zmq::socket_t &socket) {
-    while (true) {
-        tuple<string, string, string> request;
-        {
-            unique_lock<mutex> lock(mtx);
-            cv.wait(lock, [] { return !requestQueue.empty(); });
+// "priority" is a class number (0 is most urgent) or "high", "normal", "low"
+int parsePriority(const msgpack::object &value) {
+    if (value.type == msgpack::type::STR) {
+        string name = value.as<string>();
+        if (name == "high") {
+            return 0;
+        }
+        if (name == "low") {
+            return config.QUEUE_PRIORITY_CLASSES - 1;
+        }
+        return 1;
+    }
+    return value.as<int>();
+}
 
-            request = requestQueue.front();
-            requestQueue.pop();
+// Worker thread function to process a bulkhead's queued requests until the
+// worker pool retires this thread
+void processQueue(zmq::socket_t &socket, int bulkhead, const atomic<bool> &stop) {
+    RequestScheduler &scheduler = schedulerFor(bulkhead);
+    bool limited = bulkhead == oltpBulkhead;
+    Request request;
+    vector<Request> shed;
+    while (!stop) {
+        shed.clear();
+        if (limited && !concurrencyLimiter.acquire()) {
+            continue;
+        }
+        bool ready = scheduler.pop(request, shed);
+        for (const Request &dropped : shed) {
+            sendBusy(socket, dropped.clientId, dropped.queryId, "Shed under load; queue wait exceeded target.", scheduler.retryAfterMs());
+            scheduler.complete(dropped.clientId);
+        }
+        if (!ready) {
+            if (limited) {
+                concurrencyLimiter.release();
+            }
+            continue;
         }
+        request.dequeued = chrono::steady_clock::now();
+        queueWaitTimes[request.priority]->record(chrono::duration_cast<chrono::microseconds>(request.dequeued - request.received).count());
+        requestsHandled.add();
+        ++busyWorkers;
 
-        const string &queryId = get<0>(request);
-        const string &query = get<1>(request);
-        const string &clientId = get<2>(request);
-        handleRequest(socket, queryId, query, clientId);
-        std::this_thread::sleep_for(std::chrono::microseconds(20));
+        // Nobody is waiting for a reply any more; don't spend a connection on it
+        if (request.deadline != chrono::steady_clock::time_point() && chrono::steady_clock::now() >= request.deadline) {
+            sendStatus(socket, request.clientId, request.queryId, "ERROR:TIMEOUT", "Deadline expired before the query ran.");
+        } else if (request.command == "stats") {
+            sendStats(socket, request);
+        } else if (request.ackMode.empty() || !request.queryName.empty() || queryRegistry.whitelistOnly() || syntheticBackend ||
+                   !handleBufferedWrite(socket, request)) {
+            handleRequest(socket, request);
+        }
+        // Nothing from this request is left in the arena
+        RequestArena::forThread().reset();
+        --busyWorkers;
+        scheduler.complete(request.clientId);
+        if (limited) {
+            concurrencyLimiter.release();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(config.WORKER_SLEEP_US));
     }
 }
 
@@ -254,20 +1036,122 @@ void initializeDatabase() {
 }
 
 int main() {
-    initializeDatabase();
-    zmq::context_t context(1);
+    if (!syntheticBackend) {
+        initializeDatabase();
+    }
+    zmq::context_t context(config.ZEROMQ_IO_THREADS);
     zmq::socket_t socket(context, ZMQ_ROUTER);
-    socket.bind("tcp://0.0.0.0:5555");
+    // Options left at 0 keep the ZeroMQ defaults
+    if (config.ZEROMQ_SNDHWM > 0) {
+        socket.set(zmq::sockopt::sndhwm, config.ZEROMQ_SNDHWM);
+    }
+    if (config.ZEROMQ_RCVHWM > 0) {
+        socket.set(zmq::sockopt::rcvhwm, config.ZEROMQ_RCVHWM);
+    }
+    if (config.ZEROMQ_SNDBUF > 0) {
+        socket.set(zmq::sockopt::sndbuf, config.ZEROMQ_SNDBUF);
+    }
+    if (config.ZEROMQ_RCVBUF > 0) {
+        socket.set(zmq::sockopt::rcvbuf, config.ZEROMQ_RCVBUF);
+    }
+    socket.bind(config.SERVER_ENDPOINT);
 
-    cout << "Server is running on tcp://0.0.0.0:5555" << endl;
+    cout << "Server is running on " << config.SERVER_ENDPOINT << endl;
 
     // Create worker threads
-    vector<thread> workers;
-    for (int i = 0; i < maxThreads; ++i) {
-        workers.emplace_back([&socket]() {
-            processQueue(socket);
+    for (int bulkhead : {oltpBulkhead, analyticBulkhead}) {
+        workerPools.emplace_back(new WorkerPool([&socket, bulkhead](const atomic<bool> &stop) {
+            processQueue(socket, bulkhead, stop);
+        }, [bulkhead]() {
+            // Workers wait in the limiter as well as in the scheduler
+            if (bulkhead == oltpBulkhead) {
+                concurrencyLimiter.interrupt();
+            }
+            schedulerFor(bulkhead).interrupt();
+        }));
+    }
+    workerPools[oltpBulkhead]->resize(config.WORKER_THREADS);
+    workerPools[analyticBulkhead]->resize(config.ANALYTIC_WORKER_THREADS);
+
+    AdminServer admin(context, config.ADMIN_ENDPOINT);
+    admin.addSetting("oltp_workers", 1, 10000,
+        [] { return workerPools[oltpBulkhead]->size(); },
+        [](long long n) { workerPools[oltpBulkhead]->resize(static_cast<int>(n)); });
+    admin.addSetting("analytic_workers", 1, 10000,
+        [] { return workerPools[analyticBulkhead]->size(); },
+        [](long long n) { workerPools[analyticBulkhead]->resize(static_cast<int>(n)); });
+    admin.addSetting("pool_size", 1, 10000,
+        [] { return connectionPool.poolSize(); },
+        [](long long n) { connectionPool.setPoolSize(static_cast<int>(n)); });
+    admin.addSetting("pool_max", 1, 10000,
+        [] { return connectionPool.maxConnections(); },
+        [](long long n) { connectionPool.setMaxConnections(static_cast<int>(n)); });
+    admin.addSetting("oltp_connections", 1, 10000,
+        [] { return connectionPool.bulkheadBudget(oltpBulkhead); },
+        [](long long n) { connectionPool.setBulkheadBudget(oltpBulkhead, static_cast<int>(n)); });
+    admin.addSetting("analytic_connections", 1, 10000,
+        [] { return connectionPool.bulkheadBudget(analyticBulkhead); },
+        [](long long n) { connectionPool.setBulkheadBudget(analyticBulkhead, static_cast<int>(n)); });
+    admin.addSetting("max_concurrency", config.CONCURRENCY_MIN, 10000,
+        [] { return concurrencyLimiter.maxLimit(); },
+        [](long long n) { concurrencyLimiter.setMaxLimit(static_cast<int>(n)); });
+    admin.addSetting("queue_capacity", 1, 10000000,
+        [] { return static_cast<long long>(requestScheduler.capacity()); },
+        [](long long n) { requestScheduler.setCapacity(n); });
+    admin.addSetting("analytic_queue_capacity", 1, 10000000,
+        [] { return static_cast<long long>(analyticScheduler.capacity()); },
+        [](long long n) { analyticScheduler.setCapacity(n); });
+    admin.addSetting("max_outstanding_per_client", 1, 10000000,
+        [] { return static_cast<long long>(requestScheduler.maxOutstandingPerClient()); },
+        [](long long n) {
+            requestScheduler.setMaxOutstandingPerClient(n);
+            analyticScheduler.setMaxOutstandingPerClient(n);
         });
+    admin.addCommand("top_queries", [](const nlohmann::json &request) {
+        static const map<string, FingerprintStats::Order> orders = {
+            {"total_time", FingerprintStats::Order::TotalTime}, {"mean_time", FingerprintStats::Order::MeanTime},
+            {"p99", FingerprintStats::Order::P99}, {"calls", FingerprintStats::Order::Calls},
+            {"errors", FingerprintStats::Order::Errors}, {"rows", FingerprintStats::Order::Rows}};
+        auto order = orders.find(request.value("order_by", "total_time"));
+        if (order == orders.end()) {
+            return nlohmann::json{{"error", "order_by must be one of total_time, mean_time, p99, calls, errors, rows"}};
+        }
+        nlohmann::json rows = nlohmann::json::array();
+        for (const FingerprintStats::Entry &entry : queryStats.top(max(0, request.value("limit", 20)), order->second)) {
+            rows.push_back({{"fingerprint", entry.fingerprint}, {"calls", entry.calls}, {"errors", entry.errors},
+                            {"total_ms", entry.totalUs / 1000.0}, {"mean_ms", entry.meanUs() / 1000.0},
+                            {"p99_ms", entry.p99Us() / 1000.0}, {"max_ms", entry.maxUs / 1000.0},
+                            {"rows", entry.rows}, {"bytes", entry.bytes}});
+        }
+        return nlohmann::json{{"queries", rows}, {"tracked", queryStats.size()}};
+    });
+    admin.addCommand("reset_query_stats", [](const nlohmann::json &) {
+        queryStats.reset();
+        return nlohmann::json{{"reset", true}};
+    });
+    admin.start();
+
+    for (int bulkhead : {oltpBulkhead, analyticBulkhead}) {
+        string label = "class=\"" + bulkheadClassifier.name(bulkhead) + "\"";
+        metricsRegistry.gauge("asyncsql_queue_depth", "Requests waiting in the queue",
+            [bulkhead] { return static_cast<double>(schedulerFor(bulkhead).size()); }, label);
+    }
+    for (int bulkhead : {oltpBulkhead, analyticBulkhead}) {
+        string label = "class=\"" + bulkheadClassifier.name(bulkhead) + "\"";
+        metricsRegistry.gauge("asyncsql_workers", "Worker threads",
+            [bulkhead] { return static_cast<double>(workerPools[bulkhead]->size()); }, label);
     }
+    metricsRegistry.gauge("asyncsql_busy_workers", "Workers handling a request",
+        [] { return static_cast<double>(busyWorkers.load()); });
+    metricsRegistry.gauge("asyncsql_pool_connections", "Pooled MySQL connections",
+        [] { return static_cast<double>(connectionPool.idleConnections()); }, "state=\"idle\"");
+    metricsRegistry.gauge("asyncsql_pool_connections", "Pooled MySQL connections",
+        [] { return static_cast<double>(connectionPool.activeConnections()); }, "state=\"active\"");
+    metricsRegistry.gauge("asyncsql_concurrency_limit", "Adaptive limit on concurrent queries",
+        [] { return static_cast<double>(concurrencyLimiter.stats().limit); });
+
+    MetricsServer metricsServer(context, config.METRICS_ENDPOINT, metricsRegistry);
+    metricsServer.start();
 
     while (true) {
         zmq::message_t clientId;
@@ -277,29 +1161,33 @@ int main() {
         // Receive client ID
         auto clientIdBytes = socket.recv(clientId, zmq::recv_flags::none);
         if (!clientIdBytes) {
-            cerr << "Failed to receive client ID." << endl;
+            Logger::instance().log(LogLevel::Warn, "Failed to receive client ID");
             continue;
         }
 
         // Receive empty frame
         auto emptyFrameBytes = socket.recv(emptyFrame, zmq::recv_flags::none);
         if (!emptyFrameBytes) {
-            cerr << "Failed to receive empty frame." << endl;
+            Logger::instance().log(LogLevel::Warn, "Failed to receive empty frame", {{"client_id", hexId(clientId.to_string())}});
             continue;
         }
 
         // Receive payload (MessagePack message)
         auto messageBytes = socket.recv(message, zmq::recv_flags::none);
         if (!messageBytes) {
-            cerr << "Failed to receive message payload." << endl;
+            Logger::instance().log(LogLevel::Warn, "Failed to receive message payload", {{"client_id", hexId(clientId.to_string())}});
             continue;
         }
 
+        auto arrived = chrono::steady_clock::now();
         string payload(static_cast<char *>(message.data()), message.size());
         if (payload.empty()) {
-            cerr << "Received empty payload." << endl;
+            Logger::instance().log(LogLevel::Warn, "Received empty payload", {{"client_id", hexId(clientId.to_string())}});
             continue;
         }
+        if (requestCapture.enabled()) {
+            requestCapture.record(clientId.to_string(), payload);
+        }
 
         try {
             // Parse MessagePack payload
@@ -309,28 +1197,90 @@ int main() {
             map<string, msgpack::object> receivedMap;
             received.convert(receivedMap);
 
-            if (receivedMap.count("id") && receivedMap.count("query")) {
-                string queryId = receivedMap["id"].as<string>();
-                string query = receivedMap["query"].as<string>();
+            string command = receivedMap.count("command") ? receivedMap["command"].as<string>() : "";
+            bool isStats = command == "stats";
+            bool isNamed = receivedMap.count("name") > 0;
+            if (command == "cancel" && receivedMap.count("id")) {
+                // Handled here rather than queued so it can overtake the request
                 string clientIdStr(static_cast<char *>(clientId.data()), clientId.size());
+                cancelRequest(socket, clientIdStr, receivedMap["id"].as<string>());
+            } else if (receivedMap.count("id") && (receivedMap.count("query") || isNamed || isStats)) {
+                Request request;
+                request.queryId = receivedMap["id"].as<string>();
+                if (isStats) {
+                    request.command = "stats";
+                } else if (isNamed) {
+                    request.queryName = receivedMap["name"].as<string>();
+                    if (receivedMap.count("params")) {
+                        request.params = toQueryParams(receivedMap["params"]);
+                    }
+                } else {
+                    request.query = receivedMap["query"].as<string>();
+                }
+                request.clientId.assign(static_cast<char *>(clientId.data()), clientId.size());
+                if (receivedMap.count("ack")) {
+                    request.ackMode = receivedMap["ack"].as<string>();
+                    if (request.ackMode != "none" && request.ackMode != "queued" && request.ackMode != "committed") {
+                        Logger::instance().log(LogLevel::Warn, "Unknown ack mode", {{"ack", request.ackMode}, {"query_id", request.queryId},
+                                                                                    {"client_id", hexId(request.clientId)}});
+                        request.ackMode.clear();
+                    }
+                }
+
+                request.received = chrono::steady_clock::now();
+                if (receivedMap.count("priority")) {
+                    request.priority = parsePriority(receivedMap["priority"]);
+                }
+                if (receivedMap.count("deadline_ms")) {
+                    request.deadline = request.received + chrono::milliseconds(receivedMap["deadline_ms"].as<int64_t>());
+                }
+                if (receivedMap.count("trace")) {
+                    request.trace = receivedMap["trace"].as<bool>();
+                }
+                if (receivedMap.count("multipart")) {
+                    request.multipart = receivedMap["multipart"].as<bool>();
+                }
+                if (receivedMap.count("trace_id")) {
+                    request.traceId = receivedMap["trace_id"].as<string>();
+                }
+                if (receivedMap.count("parent_span_id")) {
+                    request.parentSpanId = receivedMap["parent_span_id"].as<string>();
+                }
+                request.arrived = arrived;
+                request.sampled = request.trace || (spanExporter.enabled() && spanExporter.sampleTrace(request.traceId));
+
+                if (!isStats) {
+                    string explicitClass = receivedMap.count("class") ? receivedMap["class"].as<string>() : "";
+                    bulkheadClassifier.classify(request, isNamed ? queryRegistry.find(request.queryName) : nullptr, explicitClass);
+                }
 
                 // Enqueue the request for processing
-                {
-                    lock_guard<mutex> lock(mtx);
-                    requestQueue.emplace(queryId, query, clientIdStr);
+                string queryId = request.queryId;
+                string clientIdStr = request.clientId;
+                RequestScheduler &scheduler = schedulerFor(request.bulkhead);
+                switch (scheduler.push(std::move(request))) {
+                    case RequestScheduler::PushResult::Accepted:
+                        break;
+                    case RequestScheduler::PushResult::ClientBusy:
+                        sendBusy(socket, clientIdStr, queryId, "Too many outstanding requests for this client.", scheduler.retryAfterMs());
+                        break;
+                    case RequestScheduler::PushResult::QueueFull:
+                        sendBusy(socket, clientIdStr, queryId, "Server queue is full.", scheduler.retryAfterMs());
+                        break;
                 }
-                cv.notify_one();
             } else {
-                cerr << "Invalid message format received." << endl;
+                Logger::instance().log(LogLevel::Warn, "Invalid message format received", {{"client_id", hexId(clientId.to_string())}});
             }
         } catch (const msgpack::unpack_error &e) {
-            cerr << "MessagePack parsing error: " << e.what() << endl;
+            Logger::instance().log(LogLevel::Warn, "MessagePack parsing error", {{"client_id", hexId(clientId.to_string())}, {"error", e.what()}});
+        } catch (const msgpack::type_error &e) {
+            Logger::instance().log(LogLevel::Warn, "MessagePack type error", {{"client_id", hexId(clientId.to_string())}, {"error", e.what()}});
         }
-        std::this_thread::sleep_for(std::chrono::microseconds(20));
+        std::this_thread::sleep_for(std::chrono::microseconds(config.RECEIVE_SLEEP_US));
     }
 
-    for (auto &worker : workers) {
-        worker.join();
+    for (auto &pool : workerPools) {
+        pool->resize(0);
     }
 
     return 0;
@@ -1,7 +1,8 @@
 #include "mySQLConnectionPool.h"
 #include <mysql_driver.h>
 #include <cppconn/connection.h>
-#include <iostream>
+#include <cppconn/statement.h>
+#include "Logger.h"
 #include <chrono>
 #include <thread>
 #include <mutex>
@@ -9,10 +10,17 @@
 #include <stdexcept>
 #include <vector>
 #include <memory>
+#include <string>
+#include <numeric>
 
-MySQLConnectionPool::MySQLConnectionPool(const std::string& host, const std::string& user, const std::string& password, const std::string& database, int poolSize, int heartbeatInterval)
-    : host_(host), user_(user), password_(password), database_(database), poolSize_(poolSize), heartbeatInterval_(heartbeatInterval), heartbeatRunning_(true) {
-    sleep(60);
+MySQLConnectionPool::MySQLConnectionPool(const std::string& host, const std::string& user, const std::string& password, const std::string& database, int poolSize, int heartbeatInterval,
+                                         const std::vector<std::string>& preparedStatements, const std::vector<int>& bulkheadBudgets,
+                                         int startupDelaySeconds, std::chrono::microseconds checkoutDelay)
+    : host_(host), user_(user), password_(password), database_(database), poolSize_(poolSize), heartbeatInterval_(heartbeatInterval),
+      checkoutDelay_(checkoutDelay), bulkheadBudgets_(bulkheadBudgets), bulkheadInUse_(bulkheadBudgets.size(), 0),
+      maxConnections_(std::accumulate(bulkheadBudgets.begin(), bulkheadBudgets.end(), 0)), heartbeatRunning_(true),
+      preparedSql_(preparedStatements) {
+    sleep(startupDelaySeconds);
     driver_ = sql::mysql::get_mysql_driver_instance();
     initializePool();
     startHeartbeat();
@@ -22,47 +30,232 @@ MySQLConnectionPool::~MySQLConnectionPool() {
     stopHeartbeat();
     std::lock_guard<std::mutex> lock(mutex_);
     for (auto& conn : connectionPool_) {
-        delete conn;
+        destroyConnection(conn);
     }
 }
 
 sql::Connection* MySQLConnectionPool::getConnection() {
-    // Small sleep for shared CPU when running several docker containers 1/2 millisecond
-    std::this_thread::sleep_for(std::chrono::microseconds(500));
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (!connectionPool_.empty()) {
-        sql::Connection* conn = connectionPool_.back();
-        connectionPool_.pop_back();
-        if (conn && conn->isValid()) {
-            return conn;
-        } else {
-            delete conn;
-            // Create a new connection if the pooled one is invalid
-            conn = driver_->connect(host_, user_, password_);
-            conn->setSchema(database_);
-            return conn;
+    // Small sleep for shared CPU when running several docker containers
+    if (checkoutDelay_.count() > 0) {
+        std::this_thread::sleep_for(checkoutDelay_);
+    }
+    sql::Connection* conn = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!connectionPool_.empty()) {
+            conn = connectionPool_.back();
+            connectionPool_.pop_back();
+        }
+        ++checkedOut_;
+    }
+    // Checking and connecting talk to the server, so they run without the
+    // lock; other workers keep checking connections out and in meanwhile
+    if (conn && !conn->isValid()) {
+        destroyConnection(conn);
+        conn = nullptr;
+    }
+    // Create a new connection if the pool is empty or the pooled one is invalid
+    if (!conn) {
+        try {
+            conn = createConnection();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --checkedOut_;
+            throw;
         }
     }
-    // Create a new connection if the pool is empty
-    sql::Connection* conn = driver_->connect(host_, user_, password_);
-    conn->setSchema(database_);
     return conn;
 }
 
 void MySQLConnectionPool::releaseConnection(sql::Connection* conn) {
+    bool valid = conn && conn->isValid();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (conn) {
+            --checkedOut_;
+        }
+        if (valid && static_cast<int>(connectionPool_.size()) < poolSize_) {
+            connectionPool_.push_back(conn);
+            return;
+        }
+    }
+    destroyConnection(conn);
+}
+
+sql::Connection* MySQLConnectionPool::getConnection(size_t bulkhead) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int& inUse = bulkheadInUse_.at(bulkhead);
+        condition_.wait(lock, [&] { return inUse < bulkheadBudgets_[bulkhead] && bulkheadsInUse_ < maxConnections_; });
+        ++inUse;
+        ++bulkheadsInUse_;
+    }
+    try {
+        return getConnection();
+    } catch (...) {
+        releaseConnection(nullptr, bulkhead);
+        throw;
+    }
+}
+
+void MySQLConnectionPool::releaseConnection(sql::Connection* conn, size_t bulkhead) {
+    if (conn) {
+        releaseConnection(conn);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --bulkheadInUse_.at(bulkhead);
+        --bulkheadsInUse_;
+    }
+    condition_.notify_all();
+}
+
+int MySQLConnectionPool::connectionsInUse(size_t bulkhead) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bulkheadInUse_.at(bulkhead);
+}
+
+int MySQLConnectionPool::bulkheadBudget(size_t bulkhead) {
     std::lock_guard<std::mutex> lock(mutex_);
-    if (conn && conn->isValid()) {
+    return bulkheadBudgets_.at(bulkhead);
+}
+
+void MySQLConnectionPool::setBulkheadBudget(size_t bulkhead, int budget) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bulkheadBudgets_.at(bulkhead) = budget;
+    }
+    condition_.notify_all();
+}
+
+int MySQLConnectionPool::maxConnections() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return maxConnections_;
+}
+
+void MySQLConnectionPool::setMaxConnections(int maxConnections) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxConnections_ = maxConnections;
+    }
+    condition_.notify_all();
+}
+
+int MySQLConnectionPool::idleConnections() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(connectionPool_.size());
+}
+
+int MySQLConnectionPool::activeConnections() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return checkedOut_;
+}
+
+int MySQLConnectionPool::poolSize() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return poolSize_;
+}
+
+void MySQLConnectionPool::setPoolSize(int poolSize) {
+    int missing;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        poolSize_ = poolSize;
+        while (static_cast<int>(connectionPool_.size()) > poolSize_) {
+            destroyConnection(connectionPool_.back());
+            connectionPool_.pop_back();
+        }
+        missing = poolSize_ - static_cast<int>(connectionPool_.size());
+    }
+    // Connect without holding the lock so workers keep getting connections
+    for (int i = 0; i < missing; ++i) {
+        sql::Connection* conn = createConnection();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (static_cast<int>(connectionPool_.size()) >= poolSize_) {
+            destroyConnection(conn);
+            break;
+        }
         connectionPool_.push_back(conn);
-    } else {
-        delete conn;
     }
 }
+
+sql::PreparedStatement* MySQLConnectionPool::getPreparedStatement(sql::Connection* conn, size_t index) {
+    if (index >= preparedSql_.size()) {
+        throw std::out_of_range("No prepared statement at index " + std::to_string(index));
+    }
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    std::vector<std::unique_ptr<sql::PreparedStatement>>& statements = connections_[conn].prepared;
+    statements.resize(preparedSql_.size());
+    if (!statements[index]) {
+        // Preparing failed when the connection was created; retry so the
+        // caller gets the real SQL error.
+        statements[index].reset(conn->prepareStatement(preparedSql_[index]));
+    }
+    return statements[index].get();
+}
+
+uint64_t MySQLConnectionPool::getConnectionId(sql::Connection* conn) {
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    auto it = connections_.find(conn);
+    return it == connections_.end() ? 0 : it->second.id;
+}
+
+uint64_t MySQLConnectionPool::connectionsOpened() {
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    return opened_;
+}
+
+uint64_t MySQLConnectionPool::connectionsClosed() {
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    return closed_;
+}
+
+sql::Connection* MySQLConnectionPool::openConnection() {
+    sql::Connection* conn = driver_->connect(host_, user_, password_);
+    conn->setSchema(database_);
+    return conn;
+}
+
 void MySQLConnectionPool::initializePool() {
     for (int i = 0; i < poolSize_; ++i) {
-        sql::Connection* conn = driver_->connect(host_, user_, password_);
-        conn->setSchema(database_);
-        connectionPool_.push_back(conn);
+        connectionPool_.push_back(createConnection());
+    }
+}
+
+sql::Connection* MySQLConnectionPool::createConnection() {
+    sql::Connection* conn = openConnection();
+    ConnectionState state;
+    {
+        std::unique_ptr<sql::Statement> stmt(conn->createStatement());
+        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT CONNECTION_ID()"));
+        if (res->next()) {
+            state.id = res->getUInt64(1);
+        }
+    }
+    state.prepared.resize(preparedSql_.size());
+    for (size_t i = 0; i < preparedSql_.size(); ++i) {
+        if (preparedSql_[i].empty()) {
+            continue;
+        }
+        try {
+            state.prepared[i].reset(conn->prepareStatement(preparedSql_[i]));
+        } catch (sql::SQLException &e) {
+            Logger::instance().log(LogLevel::Error, "Failed to prepare statement", {{"sql", preparedSql_[i]}, {"error", e.what()}});
+        }
+    }
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    connections_[conn] = std::move(state);
+    ++opened_;
+    return conn;
+}
+
+void MySQLConnectionPool::destroyConnection(sql::Connection* conn) {
+    {
+        // Prepared statements must go before the connection they belong to
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        closed_ += connections_.erase(conn);
     }
+    delete conn;
 }
 
 void MySQLConnectionPool::startHeartbeat() {
@@ -88,7 +281,7 @@ void MySQLConnectionPool::checkConnections() {
     std::lock_guard<std::mutex> lock(mutex_);
     for (auto it = connectionPool_.begin(); it != connectionPool_.end(); ) {
         if (!(*it)->isValid()) {
-            delete *it;
+            destroyConnection(*it);
             it = connectionPool_.erase(it);
         } else {
             ++it;
@@ -6,21 +6,67 @@
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <memory>
+#include <unordered_map>
+#include <chrono>
 #include <mysql_driver.h>
 #include <mysql_connection.h>
 #include <cppconn/resultset.h>
+#include <cppconn/prepared_statement.h>
 #include <boost/variant.hpp>
 
 class MySQLConnectionPool {
 public:
-    MySQLConnectionPool(const std::string& host, const std::string& user, const std::string& password, const std::string& database, int poolSize, int heartbeatInterval);
+    // preparedStatements are prepared on every connection the pool creates and
+    // fetched with getPreparedStatement(conn, index). Empty entries are skipped.
+    // bulkheadBudgets caps how many connections each bulkhead may have
+    // checked out at once, so one class of work can't take the whole pool.
+    // The pool waits startupDelaySeconds for MySQL to come up before
+    // connecting, and checkoutDelay before handing out each connection.
+    MySQLConnectionPool(const std::string& host, const std::string& user, const std::string& password, const std::string& database, int poolSize, int heartbeatInterval,
+                        const std::vector<std::string>& preparedStatements = std::vector<std::string>(),
+                        const std::vector<int>& bulkheadBudgets = std::vector<int>(),
+                        int startupDelaySeconds = 60,
+                        std::chrono::microseconds checkoutDelay = std::chrono::microseconds(500));
     ~MySQLConnectionPool();
     sql::Connection* getConnection();
     void releaseConnection(sql::Connection* conn);
+    // Checks out a connection against the bulkhead's budget, waiting while
+    // the bulkhead has all of its budget in use.
+    sql::Connection* getConnection(size_t bulkhead);
+    void releaseConnection(sql::Connection* conn, size_t bulkhead);
+    int connectionsInUse(size_t bulkhead);
+    int bulkheadBudget(size_t bulkhead);
+    void setBulkheadBudget(size_t bulkhead, int budget);
+    // Most connections checked out through bulkheads at once, whatever their
+    // budgets; starts as the sum of the budgets. Lowering it makes checkouts
+    // wait until enough connections in use are released.
+    int maxConnections();
+    void setMaxConnections(int maxConnections);
+    // Number of idle connections kept open. Growing opens the missing
+    // connections right away; shrinking closes idle ones, and connections in
+    // use are closed when released.
+    int poolSize();
+    void setPoolSize(int poolSize);
+    int idleConnections();
+    int activeConnections(); // checked out and not yet released
+    // Statement preparedStatements[index] prepared on conn, which must be
+    // checked out of this pool.
+    sql::PreparedStatement* getPreparedStatement(sql::Connection* conn, size_t index);
+    // Server-side thread id (CONNECTION_ID()) of a pooled connection, for KILL QUERY
+    uint64_t getConnectionId(sql::Connection* conn);
+    // A new connection outside the pool; the caller owns and deletes it
+    sql::Connection* openConnection();
+    // Connections created and destroyed by the pool since it started, for
+    // measuring churn
+    uint64_t connectionsOpened();
+    uint64_t connectionsClosed();
 
 
 private:
     void initializePool();
+    sql::Connection* createConnection();
+    void destroyConnection(sql::Connection* conn);
     void startHeartbeat();
     void stopHeartbeat();
     void checkConnections();
@@ -32,12 +78,28 @@ private:
     std::string database_;
     int poolSize_;
     int heartbeatInterval_;
+    std::chrono::microseconds checkoutDelay_;
     sql::mysql::MySQL_Driver* driver_;
     std::vector<sql::Connection*> connectionPool_;
     std::mutex mutex_;
     std::condition_variable condition_;
+    std::vector<int> bulkheadBudgets_;
+    std::vector<int> bulkheadInUse_; // guarded by mutex_
+    int maxConnections_;             // guarded by mutex_
+    int bulkheadsInUse_ = 0;         // sum of bulkheadInUse_, guarded by mutex_
+    int checkedOut_ = 0;             // guarded by mutex_
     std::thread heartbeatThread_;
     bool heartbeatRunning_ = true;
+    std::vector<std::string> preparedSql_;
+    // Per-connection state, keyed by the pooled connection
+    struct ConnectionState {
+        uint64_t id = 0;
+        std::vector<std::unique_ptr<sql::PreparedStatement>> prepared;
+    };
+    std::unordered_map<sql::Connection*, ConnectionState> connections_;
+    uint64_t opened_ = 0; // guarded by connectionsMutex_
+    uint64_t closed_ = 0; // guarded by connectionsMutex_
+    std::mutex connectionsMutex_;
 };
 
 
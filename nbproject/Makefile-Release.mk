@@ -36,7 +36,29 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 # Object Files
 OBJECTFILES= \
 	${OBJECTDIR}/main.o \
-	${OBJECTDIR}/mySQLConnectionPool.o
+	${OBJECTDIR}/mySQLConnectionPool.o \
+	${OBJECTDIR}/SqlStatement.o \
+	${OBJECTDIR}/WriteBehindBuffer.o \
+	${OBJECTDIR}/QueryRegistry.o \
+	${OBJECTDIR}/LookupCoalescer.o \
+	${OBJECTDIR}/TableCache.o \
+	${OBJECTDIR}/RequestScheduler.o \
+	${OBJECTDIR}/QueryWatchdog.o \
+	${OBJECTDIR}/ConcurrencyLimiter.o \
+	${OBJECTDIR}/BulkheadClassifier.o \
+	${OBJECTDIR}/WorkerPool.o \
+	${OBJECTDIR}/AdminServer.o \
+	${OBJECTDIR}/AppConfig.o \
+	${OBJECTDIR}/Metrics.o \
+	${OBJECTDIR}/MetricsServer.o \
+	${OBJECTDIR}/FingerprintStats.o \
+	${OBJECTDIR}/Logger.o \
+	${OBJECTDIR}/SpanExporter.o \
+	${OBJECTDIR}/RequestCapture.o \
+	${OBJECTDIR}/MySqlBackend.o \
+	${OBJECTDIR}/SyntheticBackend.o \
+	${OBJECTDIR}/WorkerMemory.o \
+	${OBJECTDIR}/ChunkedReply.o
 
 
 # C Compiler Flags
@@ -66,12 +88,122 @@ ${CND_DISTDIR}/${CND_CONF}/${CND_PLATFORM}/cppzeromqasynchsqlserver: ${OBJECTFIL
 ${OBJECTDIR}/main.o: main.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
-	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++14  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/main.o main.cpp
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/main.o main.cpp
 
 ${OBJECTDIR}/mySQLConnectionPool.o: mySQLConnectionPool.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
-	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++14  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/mySQLConnectionPool.o mySQLConnectionPool.cpp
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/mySQLConnectionPool.o mySQLConnectionPool.cpp
+
+${OBJECTDIR}/SqlStatement.o: SqlStatement.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SqlStatement.o SqlStatement.cpp
+
+${OBJECTDIR}/WriteBehindBuffer.o: WriteBehindBuffer.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/WriteBehindBuffer.o WriteBehindBuffer.cpp
+
+${OBJECTDIR}/QueryRegistry.o: QueryRegistry.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QueryRegistry.o QueryRegistry.cpp
+
+${OBJECTDIR}/LookupCoalescer.o: LookupCoalescer.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/LookupCoalescer.o LookupCoalescer.cpp
+
+${OBJECTDIR}/TableCache.o: TableCache.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/TableCache.o TableCache.cpp
+
+${OBJECTDIR}/RequestScheduler.o: RequestScheduler.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/RequestScheduler.o RequestScheduler.cpp
+
+${OBJECTDIR}/QueryWatchdog.o: QueryWatchdog.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QueryWatchdog.o QueryWatchdog.cpp
+
+${OBJECTDIR}/ConcurrencyLimiter.o: ConcurrencyLimiter.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ConcurrencyLimiter.o ConcurrencyLimiter.cpp
+
+${OBJECTDIR}/BulkheadClassifier.o: BulkheadClassifier.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/BulkheadClassifier.o BulkheadClassifier.cpp
+
+${OBJECTDIR}/WorkerPool.o: WorkerPool.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/WorkerPool.o WorkerPool.cpp
+
+${OBJECTDIR}/AdminServer.o: AdminServer.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/AdminServer.o AdminServer.cpp
+
+${OBJECTDIR}/AppConfig.o: AppConfig.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/AppConfig.o AppConfig.cpp
+
+${OBJECTDIR}/Metrics.o: Metrics.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Metrics.o Metrics.cpp
+
+${OBJECTDIR}/MetricsServer.o: MetricsServer.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/MetricsServer.o MetricsServer.cpp
+
+${OBJECTDIR}/FingerprintStats.o: FingerprintStats.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/FingerprintStats.o FingerprintStats.cpp
+
+${OBJECTDIR}/Logger.o: Logger.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Logger.o Logger.cpp
+
+${OBJECTDIR}/SpanExporter.o: SpanExporter.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SpanExporter.o SpanExporter.cpp
+
+${OBJECTDIR}/RequestCapture.o: RequestCapture.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/RequestCapture.o RequestCapture.cpp
+
+${OBJECTDIR}/MySqlBackend.o: MySqlBackend.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/MySqlBackend.o MySqlBackend.cpp
+
+${OBJECTDIR}/SyntheticBackend.o: SyntheticBackend.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SyntheticBackend.o SyntheticBackend.cpp
+
+${OBJECTDIR}/WorkerMemory.o: WorkerMemory.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/WorkerMemory.o WorkerMemory.cpp
+
+${OBJECTDIR}/ChunkedReply.o: ChunkedReply.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O3 -Inlohmann -I. -I/usr/local/include -Imsgpack-c -Imsgpack-c/include/msgpack -Imsgpack-c/include `pkg-config --cflags libmariadb` `pkg-config --cflags libzmq` -std=c++17  -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ChunkedReply.o ChunkedReply.cpp
 
 # Subprojects
 .build-subprojects: